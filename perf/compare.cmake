@@ -0,0 +1,152 @@
+# Compares the metrics of a perf run against a committed baseline.
+#
+#   cmake -DRESULTS=run.json -DBASELINE=perf/bench.json [-DREPORT=report.json]
+#         [-DTOLERANCE=percent] [-DUPDATE=ON] -P perf/compare.cmake
+#
+# Both files have a "metrics" object and every metric is lower is better. The
+# baseline keeps a "baseline" value and an optional "tolerance" (in percent)
+# per metric, the default is the file's "tolerance", or TOLERANCE when given.
+# A metric fails when it is more than its tolerance above the baseline.
+# UPDATE=ON writes the results into the baseline instead, keeping the
+# tolerances.
+
+cmake_minimum_required(VERSION 3.19)
+
+foreach(var RESULTS BASELINE)
+	if(NOT DEFINED ${var})
+		message(FATAL_ERROR "ERROR: Perf: ${var} is not set")
+	endif()
+endforeach()
+
+file(READ "${RESULTS}" results)
+file(READ "${BASELINE}" baseline)
+
+# cmake only does integer math, numbers are compared in millionths. cmake
+# writes small numbers with an exponent (4.4e-05) when it updates a baseline.
+function(to_micro value out)
+	if(NOT value MATCHES "^([0-9]*)\\.?([0-9]*)[eE]?([-+]?[0-9]*)$")
+		message(FATAL_ERROR "ERROR: Perf: ${value} is not a positive number")
+	endif()
+	set(digits "${CMAKE_MATCH_1}${CMAKE_MATCH_2}")
+	set(exponent "${CMAKE_MATCH_3}")
+	string(LENGTH "${CMAKE_MATCH_1}" point)
+	if(exponent)
+		math(EXPR point "${point} + ${exponent}")
+	endif()
+
+	# moves the decimal point 6 places right and drops what is after it
+	math(EXPR point "${point} + 6")
+	if(point LESS_EQUAL 0)
+		set(${out} 0 PARENT_SCOPE)
+		return()
+	endif()
+	string(LENGTH "${digits}" length)
+	while(length LESS point)
+		string(APPEND digits 0)
+		math(EXPR length "${length} + 1")
+	endwhile()
+	string(SUBSTRING "${digits}" 0 ${point} digits)
+	# REGEX REPLACE would apply an anchored pattern again after every match
+	string(REGEX MATCH "[1-9][0-9]*$|0$" digits "${digits}")
+	set(${out} ${digits} PARENT_SCOPE)
+endfunction()
+
+string(JSON default_tolerance ERROR_VARIABLE error GET "${baseline}" tolerance)
+if(error)
+	set(default_tolerance 0)
+endif()
+if(DEFINED TOLERANCE AND NOT TOLERANCE STREQUAL "")
+	set(default_tolerance ${TOLERANCE})
+endif()
+
+string(JSON baseline_count LENGTH "${baseline}" metrics)
+
+if(UPDATE)
+	# the metrics already in the baseline are the ones gated, all of them
+	# when it has none yet.
+	set(source "${baseline}")
+	if(baseline_count EQUAL 0)
+		set(source "${results}")
+	endif()
+	string(JSON count LENGTH "${source}" metrics)
+
+	set(updated "${baseline}")
+	math(EXPR last "${count} - 1")
+	foreach(i RANGE ${last})
+		string(JSON name MEMBER "${source}" metrics ${i})
+		string(JSON value ERROR_VARIABLE error GET "${results}" metrics "${name}")
+		if(error)
+			message(WARNING "Perf: ${name} was not measured, its baseline is kept")
+			continue()
+		endif()
+
+		set(entry "{\"baseline\": ${value}}")
+		string(JSON tolerance ERROR_VARIABLE error GET "${baseline}" metrics "${name}" tolerance)
+		if(NOT error)
+			string(JSON entry SET "${entry}" tolerance ${tolerance})
+		endif()
+
+		string(JSON updated SET "${updated}" metrics "${name}" "${entry}")
+	endforeach()
+
+	file(WRITE "${BASELINE}" "${updated}\n")
+	message(STATUS "Perf: wrote ${count} metrics to ${BASELINE}")
+	return()
+endif()
+
+set(report "{}")
+set(failed 0)
+
+if(baseline_count GREATER 0)
+	math(EXPR last "${baseline_count} - 1")
+	foreach(i RANGE ${last})
+		string(JSON name MEMBER "${baseline}" metrics ${i})
+		string(JSON expected GET "${baseline}" metrics "${name}" baseline)
+		string(JSON tolerance ERROR_VARIABLE error GET "${baseline}" metrics "${name}" tolerance)
+		if(error)
+			set(tolerance ${default_tolerance})
+		endif()
+
+		string(JSON value ERROR_VARIABLE error GET "${results}" metrics "${name}")
+		if(error)
+			message(SEND_ERROR "ERROR: Perf: ${name} is in the baseline but was not measured")
+			math(EXPR failed "${failed} + 1")
+			string(JSON report SET "${report}" "${name}" "{\"baseline\": ${expected}, \"status\": \"missing\"}")
+			continue()
+		endif()
+
+		to_micro(${expected} expected_micro)
+		to_micro(${value} value_micro)
+		# tolerances can have a fraction too (12.5), they are taken in
+		# thousandths of a percent. The baseline is split so the product
+		# doesn't overflow 64 bits for large counts.
+		to_micro(${tolerance} tolerance_milli)
+		math(EXPR tolerance_milli "${tolerance_milli} / 1000")
+		math(EXPR limit_micro "${expected_micro} + ${expected_micro} / 100000 * ${tolerance_milli} + ${expected_micro} % 100000 * ${tolerance_milli} / 100000")
+
+		if(value_micro GREATER limit_micro)
+			set(status "regressed")
+			math(EXPR failed "${failed} + 1")
+			message(SEND_ERROR "ERROR: Perf: ${name} regressed: ${value}, baseline ${expected} +${tolerance}%")
+		elseif(value_micro LESS expected_micro)
+			set(status "improved")
+			message(STATUS "Perf: ${name} improved: ${value}, baseline ${expected}")
+		else()
+			set(status "ok")
+			message(STATUS "Perf: ${name}: ${value}, baseline ${expected} +${tolerance}%")
+		endif()
+
+		string(JSON report SET "${report}" "${name}"
+			"{\"baseline\": ${expected}, \"value\": ${value}, \"tolerance\": ${tolerance}, \"status\": \"${status}\"}")
+	endforeach()
+endif()
+
+if(DEFINED REPORT)
+	file(WRITE "${REPORT}" "${report}\n")
+endif()
+
+if(failed GREATER 0)
+	message(FATAL_ERROR "Perf: ${failed} of ${baseline_count} metrics regressed")
+endif()
+
+message(STATUS "Perf: ${baseline_count} metrics within their baseline")
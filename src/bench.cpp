@@ -0,0 +1,405 @@
+// it_bench: times maze generation, meshing, solving and printing over a range
+// of sizes. Prints a table, and the same numbers as JSON with --json.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#define NULL_DEVICE "NUL"
+#else
+#include <sys/resource.h>
+#define NULL_DEVICE "/dev/null"
+#endif
+
+#include "jobs.h"
+#include "maze.h"
+
+#define BENCH_DEFAULT_SIZES  "10,32,64,128,256"
+#define BENCH_DEFAULT_REPEAT 3
+#define BENCH_DEFAULT_SEED   1
+#define BENCH_WALL_SIZE      10.0f
+// a whole mesh of 256^3 is several GB, mazes that big are streamed instead.
+#define BENCH_DEFAULT_MESH_MAX 128
+
+// every allocation made through new, counted so a benchmark can report the
+// ones its workload made.
+static std::atomic<uint64_t> allocations{0};
+static std::atomic<uint64_t> allocated_bytes{0};
+
+void* operator new(size_t bytes) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    if (void* p = std::malloc(bytes ? bytes : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t bytes) {
+    return operator new(bytes);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+static size_t peak_rss_kb() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize / 1024;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+#endif
+}
+
+struct bench_options {
+    std::vector<int> sizes;
+    int repeat = BENCH_DEFAULT_REPEAT;
+    uint32_t seed = BENCH_DEFAULT_SEED;
+    int mesh_max = BENCH_DEFAULT_MESH_MAX;
+    // only run the benchmarks whose name contains filter.
+    const char* filter = nullptr;
+    const char* json_path = nullptr;
+    // job workers meshing runs on, -1 for the pool's default.
+    int workers = -1;
+};
+
+struct bench_result {
+    std::string name;
+    int size;
+    uint64_t cells;
+    // fastest of the runs.
+    double seconds;
+    uint64_t vertices;
+    // of the first (cold) run.
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    size_t peak_rss_kb;
+};
+
+/**
+ * @brief Times a workload. setup runs before every run, outside the timing,
+ * run returns the number of vertices it produced (0 if it doesn't).
+ */
+template <typename Setup, typename Run>
+static bench_result measure(const char* name, int size, int repeat, Setup setup, Run run) {
+    bench_result result = {};
+    result.name = name;
+    result.size = size;
+    result.cells = (uint64_t)size * size * size;
+    result.seconds = 1e30;
+
+    for (int i = 0; i < repeat; i++) {
+        setup();
+
+        uint64_t allocations_before = allocations.load();
+        uint64_t bytes_before = allocated_bytes.load();
+        auto start = std::chrono::steady_clock::now();
+
+        result.vertices = run();
+
+        auto end = std::chrono::steady_clock::now();
+        double seconds = std::chrono::duration<double>(end - start).count();
+        result.seconds = std::min(result.seconds, seconds);
+
+        if (i == 0) {
+            result.allocations = allocations.load() - allocations_before;
+            result.allocated_bytes = allocated_bytes.load() - bytes_before;
+        }
+    }
+
+    result.peak_rss_kb = peak_rss_kb();
+    return result;
+}
+
+/**
+ * @brief Breadth first search from a corner through the passages, over the
+ * whole maze so every size does the same work per cell.
+ *
+ * @return The number of cells reached, all of them for a perfect maze.
+ */
+static uint64_t solve(const maze& m) {
+    const uint32_t dirs[] = { XPOSITIVE, XNEGATIVE, YPOSITIVE, YNEGATIVE, ZPOSITIVE, ZNEGATIVE };
+
+    glm::ivec3 size = m.get_size();
+    auto pack = [size](glm::ivec3 p) {
+        return (uint32_t)((p.z * size.y + p.y) * size.x + p.x);
+    };
+    auto unpack = [size](uint32_t i) {
+        return glm::ivec3(i % size.x, (i / size.x) % size.y, i / (size.x * size.y));
+    };
+
+    std::vector<uint8_t> visited((size_t)size.x * size.y * size.z, 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(visited.size());
+
+    queue.push_back(pack(glm::ivec3(0)));
+    visited[queue[0]] = 1;
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        glm::ivec3 p = unpack(queue[head]);
+        uint8_t c = m.cell(p);
+        for (uint32_t d : dirs) {
+            glm::ivec3 next = p + direction(d);
+            if (!(c & d) || !m.in_bounds(next))
+                continue;
+
+            uint32_t i = pack(next);
+            if (!visited[i]) {
+                visited[i] = 1;
+                queue.push_back(i);
+            }
+        }
+    }
+
+    return queue.size();
+}
+
+static std::vector<bench_result> run_size(int size, const bench_options& opts) {
+    std::vector<bench_result> results;
+    auto wanted = [&](const char* name) {
+        return !opts.filter || std::strstr(name, opts.filter);
+    };
+
+    glm::ivec3 dims(size);
+    std::unique_ptr<maze> m;
+
+    // every other benchmark needs a generated maze, so this always runs
+    results.push_back(measure("create_paths", size, opts.repeat,
+            [&] { m = std::make_unique<maze>(dims, opts.seed); },
+            [&] { m->create_paths(glm::ivec3(0)); return (uint64_t) 0; }));
+
+    if (!wanted("create_paths"))
+        results.pop_back();
+
+    if (wanted("gen_vertices") && size <= opts.mesh_max) {
+        results.push_back(measure("gen_vertices", size, opts.repeat,
+                [] {},
+                [&] {
+                    m->gen_vertices(BENCH_WALL_SIZE);
+                    return (uint64_t) m->get_mesh_vertices();
+                }));
+    }
+
+    if (wanted("solve")) {
+        results.push_back(measure("solve", size, opts.repeat,
+                [] {},
+                [&] {
+                    if (solve(*m) != (uint64_t) size * size * size)
+                        std::fprintf(stderr, "ERROR: Bench: maze of size %d is not connected\n", size);
+                    return (uint64_t) 0;
+                }));
+    }
+
+    if (wanted("print")) {
+        std::FILE* null_out = std::fopen(NULL_DEVICE, "w");
+        if (null_out) {
+            results.push_back(measure("print", size, opts.repeat,
+                    [] {},
+                    [&] { m->print(null_out); std::fflush(null_out); return (uint64_t) 0; }));
+            std::fclose(null_out);
+        }
+    }
+
+    return results;
+}
+
+static void print_table(const std::vector<bench_result>& results) {
+    std::printf("%-14s %5s %12s %14s %14s %12s %14s %12s\n",
+                "benchmark", "size", "ms", "cells/s", "vertices/s",
+                "allocs", "alloc bytes", "peak rss kb");
+
+    for (const bench_result& r : results) {
+        std::printf("%-14s %5d %12.3f %14.0f %14.0f %12llu %14llu %12zu\n",
+                    r.name.c_str(),
+                    r.size,
+                    r.seconds * 1e3,
+                    r.cells / r.seconds,
+                    r.vertices / r.seconds,
+                    (unsigned long long) r.allocations,
+                    (unsigned long long) r.allocated_bytes,
+                    r.peak_rss_kb);
+    }
+}
+
+static bool write_json(const char* path, const bench_options& opts, const std::vector<bench_result>& results) {
+    std::FILE* f = std::fopen(path, "w");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Bench: could not create %s\n", path);
+        return false;
+    }
+
+    std::fprintf(f, "{\n  \"seed\": %u,\n  \"repeat\": %d,\n  \"workers\": %d,\n  \"benchmarks\": [\n",
+                 opts.seed, opts.repeat, job_workers());
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const bench_result& r = results[i];
+        std::fprintf(
+                f,
+                "    {\"name\": \"%s\", \"size\": %d, \"cells\": %llu, "
+                "\"seconds\": %.9f, \"cells_per_second\": %.1f, "
+                "\"vertices\": %llu, \"vertices_per_second\": %.1f, "
+                "\"allocations\": %llu, \"allocated_bytes\": %llu, "
+                "\"peak_rss_kb\": %zu}%s\n",
+                r.name.c_str(),
+                r.size,
+                (unsigned long long) r.cells,
+                r.seconds,
+                r.cells / r.seconds,
+                (unsigned long long) r.vertices,
+                r.vertices / r.seconds,
+                (unsigned long long) r.allocations,
+                (unsigned long long) r.allocated_bytes,
+                r.peak_rss_kb,
+                i + 1 < results.size() ? "," : "");
+    }
+
+    // the same results keyed by name, all lower is better, for the perf gate
+    std::fprintf(f, "  ],\n  \"metrics\": {\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const bench_result& r = results[i];
+        if (r.vertices)
+            std::fprintf(f, "    \"bench.%s.%d.vertices\": %llu,\n",
+                         r.name.c_str(), r.size, (unsigned long long) r.vertices);
+        std::fprintf(f,
+                     "    \"bench.%s.%d.seconds\": %.9f,\n"
+                     "    \"bench.%s.%d.allocations\": %llu%s\n",
+                     r.name.c_str(), r.size, r.seconds,
+                     r.name.c_str(), r.size, (unsigned long long) r.allocations,
+                     i + 1 < results.size() ? "," : "");
+    }
+
+    std::fprintf(f, "  }\n}\n");
+    return std::fclose(f) == 0;
+}
+
+static void usage(const char* name) {
+    std::fprintf(
+            stderr,
+            "usage: %s [options]\n"
+            "  --sizes N,N,...  maze edge lengths (default %s)\n"
+            "  --repeat N       runs per benchmark, the fastest counts (default %d)\n"
+            "  --seed N         generation seed (default %d)\n"
+            "  --mesh-max N     largest size gen_vertices runs at (default %d)\n"
+            "  --filter NAME    only run benchmarks whose name contains NAME\n"
+            "                   (create_paths, gen_vertices, solve, print)\n"
+            "  --json FILE      also write the results to FILE as JSON\n"
+            "  --workers N      job workers next to the calling thread, 0 runs\n"
+            "                   everything on it (default one per hardware thread)\n",
+            name,
+            BENCH_DEFAULT_SIZES,
+            BENCH_DEFAULT_REPEAT,
+            BENCH_DEFAULT_SEED,
+            BENCH_DEFAULT_MESH_MAX);
+}
+
+static bool parse_sizes(const char* s, std::vector<int>& sizes) {
+    sizes.clear();
+    while (*s) {
+        char* end;
+        long n = std::strtol(s, &end, 10);
+        if (end == s || n <= 0)
+            return false;
+
+        sizes.push_back((int) n);
+        s = *end == ',' ? end + 1 : end;
+    }
+
+    return !sizes.empty();
+}
+
+static bool parse_bench_options(int argc, char** argv, bench_options& opts) {
+    parse_sizes(BENCH_DEFAULT_SIZES, opts.sizes);
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (!std::strcmp(arg, "--sizes") && value) {
+            if (!parse_sizes(value, opts.sizes)) {
+                std::fprintf(stderr, "bad sizes: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--repeat") && value) {
+            opts.repeat = std::max(1, std::atoi(value));
+            i++;
+        } else if (!std::strcmp(arg, "--seed") && value) {
+            opts.seed = std::strtoul(value, nullptr, 0);
+            i++;
+        } else if (!std::strcmp(arg, "--mesh-max") && value) {
+            opts.mesh_max = std::atoi(value);
+            i++;
+        } else if (!std::strcmp(arg, "--filter") && value) {
+            opts.filter = value;
+            i++;
+        } else if (!std::strcmp(arg, "--json") && value) {
+            opts.json_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--workers") && value) {
+            opts.workers = std::max(0, std::atoi(value));
+            i++;
+        } else {
+            if (std::strcmp(arg, "--help"))
+                std::fprintf(stderr, "unknown option: %s\n", arg);
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    bench_options opts;
+    if (!parse_bench_options(argc, argv, opts))
+        return 1;
+
+    // started before the first benchmark, its threads aren't counted in it
+    job_set_workers(opts.workers);
+    job_workers();
+
+    std::vector<bench_result> results;
+    for (int size : opts.sizes) {
+        std::vector<bench_result> r = run_size(size, opts);
+        results.insert(results.end(), r.begin(), r.end());
+    }
+
+    print_table(results);
+
+    if (opts.json_path && !write_json(opts.json_path, opts, results))
+        return 1;
+
+    return 0;
+}
@@ -0,0 +1,259 @@
+// it-gen: generates mazes on a pool of threads, checks every one of them and
+// writes them out as maze files or text. Doesn't need SDL or GL.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "maze.h"
+
+#define GEN_DEFAULT_COUNT 100
+#define GEN_DEFAULT_SIZE  32
+#define GEN_DEFAULT_SEED  1
+// stdio buffer of every text file, a row is written with one fwrite.
+#define GEN_TEXT_BUFFER   (1 << 20)
+
+enum gen_format { GEN_FORMAT_BINARY, GEN_FORMAT_TEXT };
+
+struct gen_options {
+    int count = GEN_DEFAULT_COUNT;
+    glm::ivec3 size = glm::ivec3(GEN_DEFAULT_SIZE);
+    // maze i gets seed + i.
+    uint32_t seed = GEN_DEFAULT_SEED;
+    int threads = 0;
+    bool validate = true;
+    // nothing is written without it.
+    const char* out_dir = nullptr;
+    gen_format format = GEN_FORMAT_BINARY;
+};
+
+/**
+ * @brief What one worker did. Times are summed over its mazes.
+ */
+struct gen_stats {
+    int mazes = 0;
+    int invalid = 0;
+    int write_failures = 0;
+    double generate_seconds = 0.0;
+    double validate_seconds = 0.0;
+    double write_seconds = 0.0;
+};
+
+/**
+ * @brief Writes the cells as text: a "it-maze W H L seed" line, then a line
+ * of two hex digits per cell for every row along x, layers of z apart.
+ */
+static bool write_text(const char* path, const maze& m) {
+    std::FILE* f = std::fopen(path, "w");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Gen: could not create %s\n", path);
+        return false;
+    }
+    std::setvbuf(f, nullptr, _IOFBF, GEN_TEXT_BUFFER);
+
+    const char digits[] = "0123456789abcdef";
+    glm::ivec3 size = m.get_size();
+
+    std::fprintf(f, "it-maze %d %d %d %u\n", size.x, size.y, size.z, m.get_seed());
+
+    std::vector<char> row(size.x * 2 + 1);
+    row.back() = '\n';
+    for (int z = 0; z < size.z; z++) {
+        for (int y = 0; y < size.y; y++) {
+            for (int x = 0; x < size.x; x++) {
+                uint8_t c = m.cell(glm::ivec3(x, y, z));
+                row[2 * x] = digits[c >> 4];
+                row[2 * x + 1] = digits[c & 0xF];
+            }
+            std::fwrite(row.data(), 1, row.size(), f);
+        }
+        std::putc('\n', f);
+    }
+
+    bool ok = !std::ferror(f);
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok)
+        std::fprintf(stderr, "ERROR: Gen: could not write %s\n", path);
+
+    return ok;
+}
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Takes mazes off next until all count are taken.
+ */
+static void worker(const gen_options& opts, std::atomic<int>& next, gen_stats& stats) {
+    for (int i = next.fetch_add(1); i < opts.count; i = next.fetch_add(1)) {
+        uint32_t seed = opts.seed + (uint32_t)i;
+
+        auto start = std::chrono::steady_clock::now();
+        maze m(opts.size, seed);
+        m.create_paths(glm::ivec3(0));
+        stats.generate_seconds += seconds_since(start);
+
+        if (opts.validate) {
+            start = std::chrono::steady_clock::now();
+            if (!m.validate()) {
+                std::fprintf(stderr, "ERROR: Gen: maze with seed %u is not valid\n", seed);
+                stats.invalid++;
+            }
+            stats.validate_seconds += seconds_since(start);
+        }
+
+        if (opts.out_dir) {
+            char path[4096];
+            std::snprintf(path, sizeof(path), "%s/maze_%08x.%s",
+                          opts.out_dir, seed, opts.format == GEN_FORMAT_TEXT ? "txt" : "maze");
+
+            start = std::chrono::steady_clock::now();
+            bool ok = opts.format == GEN_FORMAT_TEXT ? write_text(path, m) : m.save(path, false);
+            if (!ok)
+                stats.write_failures++;
+            stats.write_seconds += seconds_since(start);
+        }
+
+        stats.mazes++;
+    }
+}
+
+static void usage(const char* name) {
+    std::fprintf(
+            stderr,
+            "usage: %s [options]\n"
+            "  --count N          mazes to generate (default %d)\n"
+            "  --size N | WxHxL   maze size in cells (default %d)\n"
+            "  --seed N           seed of the first maze, the next ones count\n"
+            "                     up from it, never past 0 (default %d)\n"
+            "  --threads N        worker threads (default one per core)\n"
+            "  --out DIR          write every maze into DIR\n"
+            "  --format FORMAT    binary (maze files it --load reads) or text\n"
+            "                     (default binary)\n"
+            "  --no-validate      skip the wall symmetry and spanning tree checks\n",
+            name,
+            GEN_DEFAULT_COUNT,
+            GEN_DEFAULT_SIZE,
+            GEN_DEFAULT_SEED);
+}
+
+static bool parse_gen_options(int argc, char** argv, gen_options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (!std::strcmp(arg, "--count") && value) {
+            opts.count = std::max(0, std::atoi(value));
+            i++;
+        } else if (!std::strcmp(arg, "--size") && value) {
+            if (!parse_maze_size(value, opts.size)) {
+                std::fprintf(stderr, "bad maze size: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--seed") && value) {
+            opts.seed = std::strtoul(value, nullptr, 0);
+            i++;
+        } else if (!std::strcmp(arg, "--threads") && value) {
+            opts.threads = std::max(1, std::atoi(value));
+            i++;
+        } else if (!std::strcmp(arg, "--out") && value) {
+            opts.out_dir = value;
+            i++;
+        } else if (!std::strcmp(arg, "--format") && value) {
+            if (!std::strcmp(value, "binary")) {
+                opts.format = GEN_FORMAT_BINARY;
+            } else if (!std::strcmp(value, "text")) {
+                opts.format = GEN_FORMAT_TEXT;
+            } else {
+                std::fprintf(stderr, "unknown format: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--no-validate")) {
+            opts.validate = false;
+        } else {
+            if (std::strcmp(arg, "--help"))
+                std::fprintf(stderr, "unknown option: %s\n", arg);
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    // the maze takes seed 0 for a random one, its file couldn't be made
+    // again from the seed in its name
+    if (opts.count && (!opts.seed || (uint64_t) opts.seed + opts.count - 1 > UINT32_MAX)) {
+        std::fprintf(stderr, "bad seed: %u, the seeds of %d mazes from it reach 0\n", opts.seed, opts.count);
+        usage(argv[0]);
+        return false;
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    gen_options opts;
+    if (!parse_gen_options(argc, argv, opts))
+        return 1;
+
+    if (!opts.threads)
+        opts.threads = std::max(1u, std::thread::hardware_concurrency());
+    opts.threads = std::min(opts.threads, std::max(1, opts.count));
+
+    if (opts.out_dir) {
+        std::error_code error;
+        std::filesystem::create_directories(opts.out_dir, error);
+        if (error) {
+            std::fprintf(stderr, "ERROR: Gen: could not create %s: %s\n", opts.out_dir, error.message().c_str());
+            return 1;
+        }
+    }
+
+    std::atomic<int> next{0};
+    std::vector<gen_stats> stats(opts.threads);
+    std::vector<std::thread> pool;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int t = 0; t < opts.threads; t++)
+        pool.emplace_back(worker, std::cref(opts), std::ref(next), std::ref(stats[t]));
+    for (std::thread& thread : pool)
+        thread.join();
+    double seconds = seconds_since(start);
+
+    gen_stats total;
+    for (const gen_stats& s : stats) {
+        total.mazes += s.mazes;
+        total.invalid += s.invalid;
+        total.write_failures += s.write_failures;
+        total.generate_seconds += s.generate_seconds;
+        total.validate_seconds += s.validate_seconds;
+        total.write_seconds += s.write_seconds;
+    }
+
+    double cells = (double)opts.size.x * opts.size.y * opts.size.z * total.mazes;
+    std::printf("%d mazes of %dx%dx%d on %d threads in %.3f s\n",
+                total.mazes, opts.size.x, opts.size.y, opts.size.z, opts.threads, seconds);
+    std::printf("  %.1f mazes/s, %.0f cells/s\n", total.mazes / seconds, cells / seconds);
+    std::printf("  thread time: generate %.3f s, validate %.3f s, write %.3f s\n",
+                total.generate_seconds, total.validate_seconds, total.write_seconds);
+
+    if (total.invalid || total.write_failures) {
+        std::fprintf(stderr, "ERROR: Gen: %d invalid mazes, %d not written\n", total.invalid, total.write_failures);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,431 @@
+#include "headless.h"
+
+#include <GL/glew.h>
+
+#ifdef IT_HAVE_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+#include "input_log.h"
+#include "memory.h"
+#include "options.h"
+#include "renderer.h"
+#include "simulation.h"
+#include "trace.h"
+
+bool load_camera_path(const char* path, std::vector<camera_key>& keys) {
+    std::FILE* f = std::fopen(path, "r");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Headless: could not open %s\n", path);
+        return false;
+    }
+
+    char line[256];
+    int line_number = 0;
+    while (std::fgets(line, sizeof(line), f)) {
+        line_number++;
+
+        const char* p = line;
+        while (*p == ' ' || *p == '\t')
+            p++;
+        if (*p == '#' || *p == '\n' || *p == '\r' || *p == '\0')
+            continue;
+
+        camera_key key;
+        if (std::sscanf(p, "%f %f %f %f %f %f",
+                        &key.pos.x, &key.pos.y, &key.pos.z,
+                        &key.front.x, &key.front.y, &key.front.z) != 6 ||
+            glm::length(key.front) == 0.0f) {
+            std::fprintf(stderr, "ERROR: Headless: %s:%d: bad camera key\n", path, line_number);
+            std::fclose(f);
+            return false;
+        }
+
+        key.front = glm::normalize(key.front);
+        keys.push_back(key);
+    }
+
+    std::fclose(f);
+
+    if (keys.empty()) {
+        std::fprintf(stderr, "ERROR: Headless: %s has no camera keys\n", path);
+        return false;
+    }
+
+    return true;
+}
+
+// t goes from 0 (first key) to 1 (last key).
+static void camera_on_path(const std::vector<camera_key>& keys,
+                           float t,
+                           glm::vec3& pos,
+                           glm::vec3& front,
+                           glm::vec3& up) {
+    float x = t * (keys.size() - 1);
+    size_t i = std::min((size_t) x, keys.size() - 1);
+    size_t j = std::min(i + 1, keys.size() - 1);
+    float alpha = x - i;
+
+    pos = glm::mix(keys[i].pos, keys[j].pos, alpha);
+    front = glm::normalize(glm::mix(keys[i].front, keys[j].front, alpha));
+
+    // keep the horizon level, unless looking straight up or down
+    glm::vec3 right = glm::cross(front, glm::vec3(0.0f, 1.0f, 0.0f));
+    if (glm::length(right) < 1e-4f)
+        right = glm::vec3(1.0f, 0.0f, 0.0f);
+    up = glm::cross(glm::normalize(right), front);
+}
+
+static bool write_screenshot(const char* path) {
+    std::vector<uint8_t> pixels(WIDTH * HEIGHT * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+
+    std::FILE* f = std::fopen(path, "wb");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Headless: could not create %s\n", path);
+        return false;
+    }
+
+    // gl rows go bottom up, ppm rows top down
+    std::fprintf(f, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+    for (int y = HEIGHT - 1; y >= 0; y--)
+        std::fwrite(pixels.data() + y * WIDTH * 3, 1, WIDTH * 3, f);
+
+    return std::fclose(f) == 0;
+}
+
+#ifdef IT_HAVE_EGL
+
+struct headless_context {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLSurface surface = EGL_NO_SURFACE;
+    EGLContext context = EGL_NO_CONTEXT;
+};
+
+static bool create_context(headless_context& ctx) {
+    // a surfaceless display needs neither a config nor a surface, drivers
+    // without it get a pbuffer the size of the window.
+    auto get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (get_platform_display)
+        ctx.display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+
+    bool surfaceless = ctx.display != EGL_NO_DISPLAY && eglInitialize(ctx.display, nullptr, nullptr);
+    if (!surfaceless) {
+        ctx.display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if (ctx.display == EGL_NO_DISPLAY || !eglInitialize(ctx.display, nullptr, nullptr)) {
+            std::fprintf(stderr, "ERROR: Headless: no EGL display\n");
+            return false;
+        }
+    }
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::fprintf(stderr, "ERROR: Headless: EGL has no desktop GL\n");
+        return false;
+    }
+
+    EGLConfig config = EGL_NO_CONFIG_KHR;
+    if (!surfaceless) {
+        const EGLint config_attribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8,
+            EGL_GREEN_SIZE, 8,
+            EGL_BLUE_SIZE, 8,
+            EGL_DEPTH_SIZE, 24,
+            EGL_NONE,
+        };
+
+        EGLint count = 0;
+        if (!eglChooseConfig(ctx.display, config_attribs, &config, 1, &count) || count < 1) {
+            std::fprintf(stderr, "ERROR: Headless: no pbuffer config\n");
+            return false;
+        }
+
+        const EGLint pbuffer_attribs[] = { EGL_WIDTH, WIDTH, EGL_HEIGHT, HEIGHT, EGL_NONE };
+        ctx.surface = eglCreatePbufferSurface(ctx.display, config, pbuffer_attribs);
+        if (ctx.surface == EGL_NO_SURFACE) {
+            std::fprintf(stderr, "ERROR: Headless: could not create a pbuffer\n");
+            return false;
+        }
+    }
+
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE,
+    };
+
+    ctx.context = eglCreateContext(ctx.display, config, EGL_NO_CONTEXT, context_attribs);
+    if (ctx.context == EGL_NO_CONTEXT) {
+        std::fprintf(stderr, "ERROR: Headless: could not create a GL 4.5 core context\n");
+        return false;
+    }
+
+    if (!eglMakeCurrent(ctx.display, ctx.surface, ctx.surface, ctx.context)) {
+        std::fprintf(stderr, "ERROR: Headless: could not make the context current\n");
+        return false;
+    }
+
+    // glewInit wants a GLX display, the function pointers don't.
+    GLenum err = glewContextInit();
+    if (err != GLEW_OK) {
+        std::fprintf(stderr, "glew error: %s\n", glewGetErrorString(err));
+        return false;
+    }
+
+    return true;
+}
+
+static void destroy_context(headless_context& ctx) {
+    if (ctx.display == EGL_NO_DISPLAY)
+        return;
+
+    eglMakeCurrent(ctx.display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (ctx.context != EGL_NO_CONTEXT)
+        eglDestroyContext(ctx.display, ctx.context);
+    if (ctx.surface != EGL_NO_SURFACE)
+        eglDestroySurface(ctx.display, ctx.surface);
+    eglTerminate(ctx.display);
+}
+
+/**
+ * @brief Writes the results as a flat map of metrics, every one of them lower
+ * is better, for the perf gate to compare against its baseline.
+ */
+static bool write_json(const char* path,
+                       const frame_profile& profile,
+                       const std::vector<double>& sorted_frame_ms,
+                       double triangles_per_frame,
+                       uint32_t camera_hash) {
+    std::FILE* f = std::fopen(path, "w");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Headless: could not create %s\n", path);
+        return false;
+    }
+
+    double total = 0.0;
+    for (double ms : sorted_frame_ms)
+        total += ms;
+
+    size_t count = sorted_frame_ms.size();
+    std::fprintf(f, "{\n  \"renderer\": \"%s\",\n  \"frames\": %zu,\n  \"camera_hash\": \"%08x\",\n",
+                 (const char*) glGetString(GL_RENDERER), count, camera_hash);
+    std::fprintf(f, "  \"metrics\": {\n");
+    std::fprintf(f, "    \"headless.frame_avg_ms\": %.6f,\n", total / count);
+    std::fprintf(f, "    \"headless.frame_p50_ms\": %.6f,\n", sorted_frame_ms[count / 2]);
+    std::fprintf(f, "    \"headless.frame_p99_ms\": %.6f,\n", sorted_frame_ms[(count * 99) / 100]);
+    std::fprintf(f, "    \"headless.triangles_per_frame\": %.1f", triangles_per_frame);
+
+    for (int t = TIMING_GPU_FIRST; t < TIMING_COUNT; t++) {
+        profile_timing timing = (profile_timing) t;
+        std::string key = frame_profile::name(timing);
+        std::replace(key.begin(), key.end(), ' ', '_');
+        std::fprintf(f, ",\n    \"headless.%s_p99_ms\": %.6f",
+                     key.c_str(), profile.percentile(timing, 0.99f));
+    }
+
+    std::fprintf(f, "\n  }\n}\n");
+    return std::fclose(f) == 0;
+}
+
+static int render_frames(maze& m,
+                         const options& opts,
+                         const std::vector<camera_key>& path,
+                         const input_log* replay,
+                         net_client* net,
+                         const std::function<bool()>& wait_for_maze) {
+    init_gl_state();
+
+    renderer r;
+    if (!r.init() || !wait_for_maze())
+        return 1;
+
+    m.init_gl();
+
+    // stands in for the window
+    GLuint fb, color_rb, depth_rb;
+    glGenFramebuffers(1, &fb);
+    glBindFramebuffer(GL_FRAMEBUFFER, fb);
+
+    glGenRenderbuffers(1, &color_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, color_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, WIDTH, HEIGHT);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_rb);
+
+    glGenRenderbuffers(1, &depth_rb);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth_rb);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, WIDTH, HEIGHT);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depth_rb);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::fprintf(stderr, "ERROR: Headless: offscreen framebuffer not complete\n");
+        return 1;
+    }
+
+    r.target_fb = fb;
+    r.show_overlay = opts.overlay;
+    r.frame_budget_ms = opts.frame_budget_ms;
+    r.occlusion_culling = opts.occlusion;
+    std::vector<point_light> torches;
+    place_torches(m, opts.lights, m.get_seed(), torches);
+    r.point_lights = torches;
+
+    // not started, it is ticked once per frame from here so a run is the
+    // same every time.
+    simulation sim;
+    sim.players = opts.players;
+    sim.replay = replay;
+    sim.net = net;
+
+    int frames = opts.frames;
+    if (!frames)
+        frames = replay ? (int) replay->ticks : HEADLESS_DEFAULT_FRAMES;
+
+    std::vector<double> frame_ms;
+    frame_ms.reserve(frames);
+    uint64_t triangles = 0;
+
+    // fnv-1a of every camera, equal between runs that saw the same frames
+    uint32_t camera_hash = 2166136261u;
+    auto hash = [&camera_hash](const glm::vec3& v) {
+        const uint8_t* bytes = (const uint8_t*) &v;
+        for (size_t i = 0; i < sizeof(v); i++)
+            camera_hash = (camera_hash ^ bytes[i]) * 16777619u;
+    };
+
+    for (int i = 0; i < frames; i++) {
+        TRACE_ZONE("frame");
+        auto start = std::chrono::steady_clock::now();
+
+        // the path only moves the first player, the others stay where they
+        // spawned
+        if (path.empty()) {
+            sim.tick();
+            sim.frames.fetch();
+            r.profile.add(TIMING_SIM, sim.frames.front().tick_time * 1e-6f);
+        }
+        const frame_state& frame = sim.frames.front();
+
+        if (net) {
+            r.point_lights = torches;
+            place_player_lights(frame.remote_pos, frame.remote_players, m.get_wall_size(), r.point_lights);
+        }
+
+        view_camera cameras[SIM_MAX_PLAYERS];
+        for (int p = 0; p < sim.players; p++) {
+            cameras[p].pos = frame.player[p].cam_pos;
+            cameras[p].front = frame.player[p].cam_front;
+            cameras[p].up = frame.player[p].cam_up;
+        }
+
+        if (!path.empty()) {
+            float t = frames > 1 ? (float) i / (frames - 1) : 0.0f;
+            camera_on_path(path, t, cameras[0].pos, cameras[0].front, cameras[0].up);
+        }
+
+        hash(cameras[0].pos);
+        hash(cameras[0].front);
+
+        m.stream(cameras[0].pos);
+        r.draw(m, cameras, sim.players);
+        triangles += r.get_triangles();
+
+        // nothing is presented, wait for the frame so it is all counted
+        glFinish();
+
+        auto end = std::chrono::steady_clock::now();
+        frame_ms.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        r.profile.add(TIMING_FRAME, frame_ms.back());
+    }
+
+    if (opts.screenshot_path) {
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, fb);
+        if (!write_screenshot(opts.screenshot_path))
+            return 1;
+    }
+
+    glDeleteFramebuffers(1, &fb);
+    glDeleteRenderbuffers(1, &color_rb);
+    glDeleteRenderbuffers(1, &depth_rb);
+
+    if (frame_ms.empty())
+        return 0;
+
+    double total = 0.0;
+    for (double ms : frame_ms)
+        total += ms;
+
+    std::sort(frame_ms.begin(), frame_ms.end());
+    std::printf(
+            "%s: %zu frames, avg %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+            (const char*) glGetString(GL_RENDERER),
+            frame_ms.size(),
+            total / frame_ms.size(),
+            frame_ms[frame_ms.size() / 2],
+            frame_ms[(frame_ms.size() * 99) / 100],
+            frame_ms.back());
+    std::printf("  camera path hash %08x\n", camera_hash);
+    if (opts.frame_budget_ms > 0.0f)
+        std::printf("  resolution scale %.3f at the end\n", r.resolution_scale);
+
+    for (int t = TIMING_GPU_FIRST; t < TIMING_COUNT; t++) {
+        profile_timing timing = (profile_timing) t;
+        std::printf("  %-14s p50 %.3f ms, p99 %.3f ms\n",
+                    frame_profile::name(timing),
+                    r.profile.percentile(timing, 0.5f),
+                    r.profile.percentile(timing, 0.99f));
+    }
+
+    for (int u = 0; u < MEMORY_COUNT; u++) {
+        memory_use use = (memory_use) u;
+        std::printf("  %-14s %.2f MB\n", memory_name(use), memory_bytes(use) / (1024.0 * 1024.0));
+    }
+
+    if (opts.json_path &&
+        !write_json(opts.json_path, r.profile, frame_ms, (double) triangles / frame_ms.size(), camera_hash))
+        return 1;
+
+    return 0;
+}
+
+int run_headless(maze& m,
+                 const options& opts,
+                 const input_log* replay,
+                 net_client* net,
+                 const std::function<bool()>& wait_for_maze) {
+    std::vector<camera_key> path;
+    if (opts.camera_path && !load_camera_path(opts.camera_path, path))
+        return 1;
+
+    headless_context ctx;
+    int result = create_context(ctx) ? render_frames(m, opts, path, replay, net, wait_for_maze) : 1;
+    destroy_context(ctx);
+    return result;
+}
+
+#else
+
+int run_headless(maze& m,
+                 const options& opts,
+                 const input_log* replay,
+                 net_client* net,
+                 const std::function<bool()>& wait_for_maze) {
+    (void)m;
+    (void)opts;
+    (void)replay;
+    (void)net;
+    (void)wait_for_maze;
+    std::fprintf(stderr, "ERROR: Headless: built without EGL\n");
+    return 1;
+}
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef IT_HEADLESS_H
+#define IT_HEADLESS_H
+
+#include <glm/glm.hpp>
+
+#include <functional>
+#include <vector>
+
+#include "maze.h"
+
+#define HEADLESS_DEFAULT_FRAMES 300
+
+struct input_log;
+struct options;
+class net_client;
+
+/**
+ * @brief A point of a scripted camera path.
+ */
+struct camera_key {
+    glm::vec3 pos;
+    glm::vec3 front;
+};
+
+/**
+ * @brief Reads a camera path, one "x y z fx fy fz" key per line. Blank lines
+ * and lines starting with # are skipped.
+ */
+bool load_camera_path(const char* path, std::vector<camera_key>& keys);
+
+/**
+ * @brief Renders opts.frames frames of m into an offscreen framebuffer on a
+ * GL context without a window (EGL surfaceless, or a pbuffer where that is
+ * missing), then prints the frame times.
+ *
+ * Without a camera path the simulation is ticked once per frame, fed from
+ * replay if there is one, so a replay gives the same camera every frame of
+ * every run. With a path the camera follows it from the first key to the last
+ * over the run. With net the first player is in its game, ticked once per
+ * frame too.
+ *
+ * m may still be being built, wait_for_maze is called once the context and
+ * the shaders are up, right before the mesh is uploaded. False stops the run.
+ *
+ * @return The exit code for main.
+ */
+int run_headless(maze& m,
+                 const options& opts,
+                 const input_log* replay,
+                 net_client* net,
+                 const std::function<bool()>& wait_for_maze);
+
+#endif
@@ -0,0 +1,96 @@
+#include "input_log.h"
+
+#include <cstdio>
+
+bool input_log::save(const char* path) const {
+    input_log_header header = {};
+    header.magic = INPUT_LOG_MAGIC;
+    header.version = INPUT_LOG_VERSION;
+    header.seed = seed;
+    header.size[0] = size.x;
+    header.size[1] = size.y;
+    header.size[2] = size.z;
+    header.tick_rate = SIM_TICK_RATE;
+    header.ticks = ticks;
+    header.records = (uint32_t) records.size();
+
+    std::FILE* f = std::fopen(path, "wb");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Input log: could not create %s\n", path);
+        return false;
+    }
+
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1
+        && std::fwrite(records.data(), sizeof(input_record), records.size(), f) == records.size();
+
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok)
+        std::fprintf(stderr, "ERROR: Input log: could not write %s\n", path);
+
+    return ok;
+}
+
+bool input_log::load(const char* path) {
+    std::FILE* f = std::fopen(path, "rb");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Input log: could not open %s\n", path);
+        return false;
+    }
+
+    input_log_header header;
+    if (std::fread(&header, sizeof(header), 1, f) != 1 || header.magic != INPUT_LOG_MAGIC) {
+        std::fprintf(stderr, "ERROR: Input log: %s is not an input log\n", path);
+        std::fclose(f);
+        return false;
+    }
+
+    bool one_player = header.version == INPUT_LOG_VERSION_ONE_PLAYER;
+    if ((header.version != INPUT_LOG_VERSION && !one_player) || header.tick_rate != SIM_TICK_RATE) {
+        std::fprintf(
+                stderr,
+                "ERROR: Input log: version %u at %u Hz, expected %u at %u Hz\n",
+                header.version,
+                header.tick_rate,
+                INPUT_LOG_VERSION,
+                SIM_TICK_RATE);
+        std::fclose(f);
+        return false;
+    }
+
+    // the maze is built from it before anything else is read
+    if (header.size[0] <= 0 || header.size[1] <= 0 || header.size[2] <= 0) {
+        std::fprintf(stderr, "ERROR: Input log: %s has a bad maze size\n", path);
+        std::fclose(f);
+        return false;
+    }
+
+    // the records have to be in the file before they are allocated
+    long start = std::ftell(f);
+    std::fseek(f, 0, SEEK_END);
+    long end = std::ftell(f);
+    std::fseek(f, start, SEEK_SET);
+    if (start < 0 || end < start || (uint64_t) header.records * sizeof(input_record) > (uint64_t) (end - start)) {
+        std::fprintf(stderr, "ERROR: Input log: %s is truncated\n", path);
+        std::fclose(f);
+        return false;
+    }
+
+    seed = header.seed;
+    size = glm::ivec3(header.size[0], header.size[1], header.size[2]);
+    ticks = header.ticks;
+    records.resize(header.records);
+
+    bool ok = std::fread(records.data(), sizeof(input_record), records.size(), f) == records.size();
+    std::fclose(f);
+
+    // the player was padding before
+    if (one_player) {
+        for (input_record& record : records)
+            record.event.player = 0;
+    }
+
+    if (!ok)
+        std::fprintf(stderr, "ERROR: Input log: %s is truncated\n", path);
+
+    return ok;
+}
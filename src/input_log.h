@@ -0,0 +1,55 @@
+#ifndef IT_INPUT_LOG_H
+#define IT_INPUT_LOG_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "simulation.h"
+
+#define INPUT_LOG_MAGIC   0x4E495449 // "ITIN"
+#define INPUT_LOG_VERSION 2
+// logs from before there was more than one player, all their input is the
+// first player's.
+#define INPUT_LOG_VERSION_ONE_PLAYER 1
+
+struct input_log_header {
+    uint32_t magic;
+    uint32_t version;
+    // the maze the input was recorded in.
+    uint32_t seed;
+    int32_t size[3];
+    uint32_t tick_rate;
+    // how long the recording ran.
+    uint32_t ticks;
+    uint32_t records;
+};
+
+static_assert(sizeof(input_log_header) == 36, "input log header has padding");
+
+/**
+ * @brief An input event and the simulation tick it was applied in. Ticks are
+ * the timestamps, replaying by tick gives the same camera path every time.
+ */
+struct input_record {
+    uint32_t tick;
+    input_event event;
+};
+
+static_assert(sizeof(input_record) == 12, "input record has padding");
+
+/**
+ * @brief Every input a simulation applied, with the maze it ran in.
+ */
+struct input_log {
+    uint32_t seed = 0;
+    glm::ivec3 size = glm::ivec3(0);
+    uint32_t ticks = 0;
+    std::vector<input_record> records;
+
+    bool save(const char* path) const;
+    bool load(const char* path);
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "jobs.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct job {
+    std::function<void()> fn;
+    job_counter* counter;
+};
+
+// The lock is per deque, it is only contended when a thief and the owner
+// meet on the same one.
+struct job_deque {
+    std::mutex lock;
+    std::deque<job> jobs;
+};
+
+/**
+ * @brief The pool behind the job_ functions. deques[workers] is the shared
+ * one of the threads that aren't workers.
+ */
+class job_pool {
+    int workers;
+    std::unique_ptr<job_deque[]> deques;
+    std::vector<std::thread> threads;
+
+    // jobs in all of the deques, the workers sleep while it is 0.
+    std::atomic<int> queued{0};
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+    bool quit = false;
+
+    void loop(int index);
+
+public:
+    job_pool();
+    ~job_pool();
+
+    int get_workers() const { return workers; }
+
+    void push(int index, job j);
+    // the newest job of index, or the oldest of another deque.
+    bool take(int index, job& j);
+    // the own deque of the calling thread.
+    int own_deque() const;
+};
+
+// index of the calling worker, -1 on other threads.
+static thread_local int worker_index = -1;
+// what job_set_workers asked for, -1 for one per hardware thread.
+static int wanted_workers = -1;
+
+job_pool::job_pool() {
+    int hardware = (int) std::thread::hardware_concurrency();
+    workers = std::clamp(wanted_workers >= 0 ? wanted_workers : hardware - 1, 0, JOB_MAX_WORKERS);
+    deques = std::make_unique<job_deque[]>(workers + 1);
+
+    for (int i = 0; i < workers; i++)
+        threads.emplace_back(&job_pool::loop, this, i);
+}
+
+job_pool::~job_pool() {
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+        quit = true;
+    }
+
+    wake.notify_all();
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+int job_pool::own_deque() const {
+    return worker_index >= 0 ? worker_index : workers;
+}
+
+void job_pool::push(int index, job j) {
+    // counted first so it never goes below 0, and before the sleep lock is
+    // taken so a worker about to sleep sees it
+    queued.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> guard(deques[index].lock);
+        deques[index].jobs.push_back(std::move(j));
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(sleep_lock);
+    }
+    wake.notify_one();
+}
+
+bool job_pool::take(int index, job& j) {
+    if (queued.load() == 0)
+        return false;
+
+    // a worker takes from the back of its own deque, what it just queued is
+    // still in the cache, and steals from the front of the others
+    for (int i = 0; i <= workers; i++) {
+        job_deque& d = deques[(index + i) % (workers + 1)];
+        bool own = i == 0 && index < workers;
+
+        std::lock_guard<std::mutex> guard(d.lock);
+        if (d.jobs.empty())
+            continue;
+
+        if (own) {
+            j = std::move(d.jobs.back());
+            d.jobs.pop_back();
+        } else {
+            j = std::move(d.jobs.front());
+            d.jobs.pop_front();
+        }
+        queued.fetch_sub(1);
+        return true;
+    }
+
+    return false;
+}
+
+static void run(job& j) {
+    j.fn();
+    if (j.counter)
+        j.counter->pending.fetch_sub(1, std::memory_order_release);
+}
+
+void job_pool::loop(int index) {
+    trace_thread_name("job worker");
+    worker_index = index;
+
+    while (true) {
+        job j;
+        if (take(index, j)) {
+            run(j);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> guard(sleep_lock);
+        wake.wait(guard, [this] { return quit || queued.load() > 0; });
+        if (quit)
+            return;
+    }
+}
+
+static job_pool& pool() {
+    static job_pool instance;
+    return instance;
+}
+
+int job_workers() {
+    return pool().get_workers();
+}
+
+void job_set_workers(int workers) {
+    wanted_workers = workers;
+}
+
+void job_run(std::function<void()> fn, job_counter* counter) {
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+    job_pool& p = pool();
+    job j{ std::move(fn), counter };
+    if (!p.get_workers())
+        run(j);
+    else
+        p.push(p.own_deque(), std::move(j));
+}
+
+void job_wait(job_counter& counter) {
+    job_pool& p = pool();
+    int index = p.own_deque();
+
+    while (!counter.done()) {
+        job j;
+        if (p.take(index, j))
+            run(j);
+        else
+            std::this_thread::yield();
+    }
+}
+
+/**
+ * @brief A job_parallel_for, shared with the helpers it queued. They can
+ * start after it returned, so they only touch fn once they got a range.
+ */
+struct job_ranges {
+    int count;
+    int grain;
+    int ranges;
+    job_range_fn call;
+    const void* fn;
+
+    std::atomic<int> next{0};
+    std::atomic<int> finished{0};
+
+    void run() {
+        for (int r = next.fetch_add(1); r < ranges; r = next.fetch_add(1)) {
+            int begin = r * grain;
+            call(fn, begin, std::min(count, begin + grain));
+            finished.fetch_add(1, std::memory_order_release);
+        }
+    }
+};
+
+void job_parallel_for(int count, int grain, job_range_fn call, const void* fn) {
+    if (count <= 0)
+        return;
+
+    grain = std::max(1, grain);
+    int ranges = (count + grain - 1) / grain;
+    int helpers = std::min(job_workers(), ranges - 1);
+    if (!helpers) {
+        for (int begin = 0; begin < count; begin += grain)
+            call(fn, begin, std::min(count, begin + grain));
+        return;
+    }
+
+    auto shared = std::make_shared<job_ranges>();
+    shared->count = count;
+    shared->grain = grain;
+    shared->ranges = ranges;
+    shared->call = call;
+    shared->fn = fn;
+
+    for (int i = 0; i < helpers; i++)
+        job_run([shared] { shared->run(); });
+
+    shared->run();
+    while (shared->finished.load(std::memory_order_acquire) < ranges)
+        std::this_thread::yield();
+}
@@ -0,0 +1,61 @@
+#ifndef IT_JOBS_H
+#define IT_JOBS_H
+
+#include <atomic>
+#include <functional>
+
+// workers past this many are never started, whatever the hardware has.
+#define JOB_MAX_WORKERS 64
+
+/**
+ * @brief Counts jobs that haven't finished, see job_run and job_wait. Has to
+ * outlive them.
+ */
+struct job_counter {
+    std::atomic<int> pending{0};
+
+    bool done() const { return pending.load(std::memory_order_acquire) == 0; }
+};
+
+// The engine wide worker pool, one thread per hardware thread but the one
+// calling, started on first use. Each worker has its own deque: it takes the
+// newest job of its own and steals the oldest of the others when it runs
+// out. Jobs from threads that aren't workers go to a shared deque every
+// worker steals from.
+
+// workers in the pool, starts it. 0 on a single hardware thread.
+int job_workers();
+
+// How many workers the pool starts with instead of one per hardware thread
+// but one, up to JOB_MAX_WORKERS. Only before its first use: 0 runs every
+// job on the thread queuing it, what runs that have to come out the same on
+// any machine use.
+void job_set_workers(int workers);
+
+// queues fn, counter (if any) goes up now and down once fn has run. Without
+// workers fn runs right away.
+void job_run(std::function<void()> fn, job_counter* counter = nullptr);
+
+// runs queued jobs, any of them, until counter is done.
+void job_wait(job_counter& counter);
+
+// what job_parallel_for calls, fn is the callable it was given.
+typedef void (*job_range_fn)(const void* fn, int begin, int end);
+
+void job_parallel_for(int count, int grain, job_range_fn call, const void* fn);
+
+/**
+ * @brief Calls fn(begin, end) over [0, count) in ranges of grain, on the
+ * workers and the calling thread, and returns once every range has run.
+ * The caller takes ranges itself and runs nothing else meanwhile, so it waits
+ * at most for the ranges already started elsewhere, even when the workers
+ * are busy: it is what the main loop calls. Allocates nothing without
+ * workers.
+ */
+template <typename F>
+void job_parallel_for(int count, int grain, const F& fn) {
+    job_range_fn call = [](const void* f, int begin, int end) { (*(const F*) f)(begin, end); };
+    job_parallel_for(count, grain, call, &fn);
+}
+
+#endif
@@ -0,0 +1,205 @@
+#include "lights.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+void place_torches(const maze& m, int count, uint32_t seed, std::vector<point_light>& lights) {
+    glm::ivec3 size = m.get_size();
+    float wall_size = m.get_wall_size();
+
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> x(0, size.x - 1);
+    std::uniform_int_distribution<int> y(0, size.y - 1);
+    std::uniform_int_distribution<int> z(0, size.z - 1);
+    std::uniform_real_distribution<float> jitter(-0.1f, 0.1f);
+
+    lights.clear();
+    for (int i = 0; i < count; i++) {
+        glm::vec3 cell(x(rng), y(rng), z(rng));
+
+        point_light light;
+        // low in the cell, the floor and the walls around it get most of it
+        light.pos = wall_size * (cell + glm::vec3(jitter(rng), -0.3f, jitter(rng)));
+        light.radius = LIGHT_TORCH_RADIUS * wall_size;
+        // every fifth one is a pickup
+        light.color = i % 5 ? glm::vec3(1.0f, 0.55f, 0.2f) : glm::vec3(0.3f, 0.8f, 1.0f);
+        light.intensity = 1.5f;
+        lights.push_back(light);
+    }
+}
+
+void place_player_lights(const glm::vec3* positions, int count, float wall_size, std::vector<point_light>& lights) {
+    for (int i = 0; i < count; i++) {
+        point_light light;
+        light.pos = positions[i];
+        light.radius = LIGHT_PLAYER_RADIUS * wall_size;
+        light.color = glm::vec3(0.4f, 1.0f, 0.4f);
+        light.intensity = 2.0f;
+        lights.push_back(light);
+    }
+}
+
+void light_grid::init() {
+    glGenBuffers(1, &light_buffer);
+    glGenBuffers(1, &cell_buffer);
+    glGenBuffers(1, &index_buffer);
+
+    cells.assign(LIGHT_GRID_CELLS, glm::uvec2(0));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, cell_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, cells.size() * sizeof(glm::uvec2), cells.data(), GL_DYNAMIC_DRAW);
+
+    // empty lists still need something bound
+    const uint32_t zero[8] = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, light_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), zero, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, index_buffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(zero), zero, GL_DYNAMIC_DRAW);
+
+    light_bytes = sizeof(zero);
+    index_bytes = sizeof(zero);
+    gpu_memory.set(cells.size() * sizeof(glm::uvec2) + light_bytes + index_bytes);
+    cpu_memory.set(cells.capacity() * sizeof(glm::uvec2));
+}
+
+// Breadth first from the cell of the light through the passages, over the
+// cells the light's sphere touches. Light going straight from one cell to
+// another crosses the faces between them, so those are all open.
+void light_grid::flood(const maze& m, uint32_t light_index, const point_light& light) {
+    const uint32_t dirs[] = { XPOSITIVE, XNEGATIVE, YPOSITIVE, YNEGATIVE, ZPOSITIVE, ZNEGATIVE };
+    float wall_size = m.get_wall_size();
+
+    glm::ivec3 start = glm::ivec3(glm::floor(light.pos / wall_size + 0.5f));
+    if (!m.in_bounds(start))
+        return;
+
+    // every cell the sphere touches is within reach of start
+    int reach = (int) std::ceil(light.radius / wall_size) + 1;
+    int side = 2 * reach + 1;
+    visited.assign((size_t) side * side * side, 0);
+    auto local = [&](glm::ivec3 p) {
+        glm::ivec3 l = p - start + reach;
+        return ((size_t) l.z * side + l.y) * side + l.x;
+    };
+
+    queue.clear();
+    queue.push_back(start);
+    visited[local(start)] = 1;
+
+    for (size_t head = 0; head < queue.size(); head++) {
+        glm::ivec3 p = queue[head];
+
+        glm::ivec3 g = p - origin;
+        if (g.x >= 0 && g.y >= 0 && g.z >= 0 &&
+            g.x < LIGHT_GRID_SIZE && g.y < LIGHT_GRID_SIZE && g.z < LIGHT_GRID_SIZE) {
+            uint32_t cell = (g.z * LIGHT_GRID_SIZE + g.y) * LIGHT_GRID_SIZE + g.x;
+            pairs.push_back(glm::uvec2(cell, light_index));
+        }
+
+        uint8_t c = m.cell(p);
+        for (uint32_t d : dirs) {
+            glm::ivec3 next = p + direction(d);
+            if (!(c & d) || !m.in_bounds(next))
+                continue;
+
+            // the neighbours of a cell at reach are outside of visited, and
+            // too far for the sphere to touch
+            glm::ivec3 away = glm::abs(next - start);
+            if (std::max(away.x, std::max(away.y, away.z)) > reach || visited[local(next)])
+                continue;
+
+            // closest point of the cell to the light
+            glm::vec3 lo = (glm::vec3(next) - 0.5f) * wall_size;
+            glm::vec3 hi = (glm::vec3(next) + 0.5f) * wall_size;
+            glm::vec3 closest = glm::clamp(light.pos, lo, hi);
+            if (glm::length(closest - light.pos) > light.radius)
+                continue;
+
+            visited[local(next)] = 1;
+            queue.push_back(next);
+        }
+    }
+}
+
+void light_grid::build(const maze& m) {
+    TRACE_ZONE("lights build");
+
+    float wall_size = m.get_wall_size();
+    glm::vec3 lo = (glm::vec3(origin) - 0.5f) * wall_size;
+    glm::vec3 hi = (glm::vec3(origin + LIGHT_GRID_SIZE) - 0.5f) * wall_size;
+
+    pairs.clear();
+    for (uint32_t i = 0; i < binned.size(); i++) {
+        const point_light& light = binned[i];
+        glm::vec3 closest = glm::clamp(light.pos, lo, hi);
+        if (glm::length(closest - light.pos) <= light.radius)
+            flood(m, i, light);
+    }
+
+    // counting sort of the pairs by cell
+    std::fill(cells.begin(), cells.end(), glm::uvec2(0));
+    for (const glm::uvec2& pair : pairs)
+        cells[pair.x].y++;
+
+    uint32_t offset = 0;
+    for (glm::uvec2& cell : cells) {
+        cell.x = offset;
+        offset += cell.y;
+        cell.y = 0;
+    }
+
+    indices.resize(pairs.size());
+    for (const glm::uvec2& pair : pairs) {
+        glm::uvec2& cell = cells[pair.x];
+        indices[cell.x + cell.y++] = pair.y;
+    }
+
+    cpu_memory.set(binned.capacity() * sizeof(point_light) +
+                   cells.capacity() * sizeof(glm::uvec2) +
+                   indices.capacity() * sizeof(uint32_t) +
+                   pairs.capacity() * sizeof(glm::uvec2) +
+                   visited.capacity() +
+                   queue.capacity() * sizeof(glm::ivec3));
+}
+
+void light_grid::upload() {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, cell_buffer);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, cells.size() * sizeof(glm::uvec2), cells.data());
+
+    if (!binned.empty()) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, light_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, binned.size() * sizeof(point_light), binned.data(), GL_DYNAMIC_DRAW);
+        light_bytes = binned.size() * sizeof(point_light);
+    }
+
+    if (!indices.empty()) {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, index_buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, indices.size() * sizeof(uint32_t), indices.data(), GL_DYNAMIC_DRAW);
+        index_bytes = indices.size() * sizeof(uint32_t);
+    }
+
+    gpu_memory.set(cells.size() * sizeof(glm::uvec2) + light_bytes + index_bytes);
+}
+
+void light_grid::update(const maze& m, glm::vec3 cam_pos, const std::vector<point_light>& lights) {
+    glm::ivec3 cam_cell = glm::ivec3(glm::floor(cam_pos / m.get_wall_size() + 0.5f));
+    glm::ivec3 new_origin = cam_cell - LIGHT_GRID_SIZE / 2;
+
+    bool same_lights = lights.size() == binned.size() &&
+        (lights.empty() || !std::memcmp(lights.data(), binned.data(), lights.size() * sizeof(point_light)));
+    if (new_origin == origin && same_lights)
+        return;
+
+    origin = new_origin;
+    binned = lights;
+    build(m);
+    upload();
+}
+
+void light_grid::bind() const {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING_LIGHTS, light_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING_CELLS, cell_buffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, LIGHT_BINDING_INDICES, index_buffer);
+}
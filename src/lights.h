@@ -0,0 +1,97 @@
+#ifndef IT_LIGHTS_H
+#define IT_LIGHTS_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "maze.h"
+#include "memory.h"
+
+// Cells along each side of the light grid, which follows the camera cell.
+// Walls outside of it only get the camera light.
+#define LIGHT_GRID_SIZE  32
+#define LIGHT_GRID_CELLS (LIGHT_GRID_SIZE * LIGHT_GRID_SIZE * LIGHT_GRID_SIZE)
+
+// how far a torch reaches, in cells.
+#define LIGHT_TORCH_RADIUS 3.0f
+// how far the light the other players of a networked game carry reaches.
+#define LIGHT_PLAYER_RADIUS 1.5f
+
+// shader storage bindings of the grid, as in SHADER_LIT_FRAG.
+#define LIGHT_BINDING_LIGHTS  0
+#define LIGHT_BINDING_CELLS   1
+#define LIGHT_BINDING_INDICES 2
+
+/**
+ * @brief A point light, laid out the way the shader reads it (two vec4).
+ * Nothing reaches past radius.
+ */
+struct point_light {
+    glm::vec3 pos;
+    float radius;
+    glm::vec3 color;
+    float intensity;
+};
+
+static_assert(sizeof(point_light) == 32, "point light doesn't match the shader");
+
+/**
+ * @brief Puts count torches in random cells of m, the same ones for the same
+ * seed.
+ */
+void place_torches(const maze& m, int count, uint32_t seed, std::vector<point_light>& lights);
+
+/**
+ * @brief Appends the lights the other players of a networked game carry,
+ * it is how they are seen.
+ */
+void place_player_lights(const glm::vec3* positions, int count, float wall_size, std::vector<point_light>& lights);
+
+/**
+ * @brief Lights binned per maze cell around the camera. A light is only
+ * listed in the cells it reaches through passages, walls stop it, so a
+ * fragment only loops over the few lights of its own cell.
+ */
+class light_grid {
+    GLuint light_buffer;
+    GLuint cell_buffer;
+    GLuint index_buffer;
+
+    // cell of the maze at grid cell 0.
+    glm::ivec3 origin = glm::ivec3(INT32_MIN);
+    // what the grid was built from, it is only rebuilt when these change.
+    std::vector<point_light> binned;
+
+    // per grid cell the first index and the count of its lights.
+    std::vector<glm::uvec2> cells;
+    std::vector<uint32_t> indices;
+
+    // (grid cell, light) pairs and flood fill scratch.
+    std::vector<glm::uvec2> pairs;
+    std::vector<uint8_t> visited;
+    std::vector<glm::ivec3> queue;
+
+    // bytes in the light and index buffers, empty lists keep the last ones.
+    size_t light_bytes = 0;
+    size_t index_bytes = 0;
+    memory_account cpu_memory{MEMORY_LIGHTS};
+    memory_account gpu_memory{MEMORY_GPU_BUFFERS};
+
+    void flood(const maze& m, uint32_t light_index, const point_light& light);
+    void build(const maze& m);
+    void upload();
+
+public:
+    void init();
+
+    // Rebinned when the camera moves into another cell or a light changed.
+    void update(const maze& m, glm::vec3 cam_pos, const std::vector<point_light>& lights);
+    void bind() const;
+
+    glm::ivec3 get_origin() const { return origin; }
+};
+
+#endif
@@ -1,84 +1,54 @@
 #include <GL/glew.h>
 #include <SDL2/SDL.h>
 #include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtc/type_ptr.hpp>
-#include <glm/gtx/rotate_vector.hpp>
 
 #include <stdbool.h>
 #include <cstdlib>
+#include <algorithm>
 #include <cstdio>
+#include <future>
 
 #include "SDL_events.h"
 #include "SDL_keycode.h"
 #include "input_controller.h"
+#include "headless.h"
+#include "input_log.h"
 #include "maze.h"
-#include "minimap.h"
-#include "shaders.h"
-
-#define WIDTH 1280
-#define HEIGHT 720
-
-bool process_event(SDL_Event event, input_controller& icontroller);
-
-// quad data
-//float quad_pos[] = {
-//     1.0f,  1.0f, 0.0f,
-//    -1.0f,  1.0f, 0.0f,
-//     1.0f, -1.0f, 0.0f,
-//
-//    -1.0f, -1.0f, 0.0f,
-//     1.0f, -1.0f, 0.0f,
-//    -1.0f,  1.0f, 0.0f,
-//};
-float quad_pos[] = {
-     0.4,  0.4, 0.0f,
-    -0.4,  0.4, 0.0f,
-     0.4, -0.4, 0.0f,
-
-    -0.4, -0.4, 0.0f,
-     0.4, -0.4, 0.0f,
-    -0.4,  0.4, 0.0f,
+#include "net_client.h"
+#include "options.h"
+#include "present.h"
+#include "renderer.h"
+#include "simulation.h"
+#include "trace.h"
+
+// stick deflection (of 32767) below which it counts as centered.
+#define PAD_DEAD_ZONE  8000
+// mouse counts per second the right stick turns by at full deflection.
+#define PAD_LOOK_SPEED 800.0f
+// longest sleep of a frame loop with nothing to draw. Only events wake it
+// sooner, the timeout is there in case a change came without one.
+#define IDLE_WAIT_MS   250
+
+static_assert(SIM_MAX_PLAYERS <= MAZE_MAX_VIEWS, "every player needs a view");
+
+/**
+ * @brief A game controller playing as one of the players after the first,
+ * who has the keyboard and mouse.
+ */
+struct gamepad {
+    SDL_GameController* controller = nullptr;
+    bool held[NUM_MOTIONS] = {};
+    // turning that didn't add up to a whole mouse count yet.
+    glm::vec2 look_rest = glm::vec2(0.0f);
 };
 
-float quad_uv[] = {
-    1.0f, 1.0f,
-    0.0f, 1.0f,
-    1.0f, 0.0f,
+bool process_event(SDL_Event event, simulation& sim);
+void process_gamepad_event(SDL_Event event, gamepad* pads, int count);
+void poll_gamepads(gamepad* pads, int count, float dt, simulation& sim, glm::ivec2* mouse_sent);
 
-    0.0f, 0.0f,
-    1.0f, 0.0f,
-    0.0f, 1.0f,
-};
-
-float arrow_pos[] = {
-    0.0f,  0.0f, 0.0f,
-    1.0f,  0.0f, 0.0f,
-    0.8f,  0.2f, 0.0f,
-    1.0f,  0.0f, 0.0f,
-    0.8f, -0.2f, 0.0f,
-};
-
-float arrow_color[] = {
-    1.0f, 1.0f, 1.0f,
-    1.0f, 1.0f, 1.0f,
-    1.0f, 1.0f, 1.0f,
-    1.0f, 1.0f, 1.0f,
-    1.0f, 1.0f, 1.0f,
-};
+void init(SDL_Window*& window, SDL_GLContext& context, present_mode present) {
 
-void opengl_message_callback(
-        GLenum source,
-        GLenum type,
-        GLuint id,
-        GLenum severity,
-        GLsizei length,
-        GLchar const* message,
-        void const* user_param);
-
-void init(SDL_Window*& window, SDL_GLContext& context) {
-
-    SDL_Init(SDL_INIT_VIDEO);
+    SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER);
     SDL_GL_SetAttribute(
             SDL_GL_CONTEXT_PROFILE_MASK,
             SDL_GL_CONTEXT_PROFILE_CORE);
@@ -95,7 +65,7 @@ void init(SDL_Window*& window, SDL_GLContext& context) {
             SDL_WINDOW_OPENGL);
     context = SDL_GL_CreateContext(window);
 
-    SDL_GL_SetSwapInterval(1);
+    set_present_mode(present);
 
     SDL_SetRelativeMouseMode(SDL_TRUE);
 
@@ -108,351 +78,309 @@ void init(SDL_Window*& window, SDL_GLContext& context) {
         std::exit(1);
     }
 
-    glEnable(GL_DEPTH_TEST);
+    init_gl_state();
+}
+
+/**
+ * @brief Generates or loads the maze of opts and meshes it, everything of it
+ * that doesn't need GL. Runs on a thread of its own during startup.
+ */
+static bool build_maze(maze& m, const options& opts) {
+    trace_thread_name("maze build");
+
+    if (opts.load_path) {
+        if (!m.load(opts.load_path))
+            return false;
+
+        if (opts.stream) {
+            if (!m.start_streaming(opts.stream_radius, opts.stream_budget_mb << 20))
+                return false;
+        } else if (!m.has_mesh()) {
+            // files saved without a mesh still have to be meshed
+            m.gen_vertices(MAZE_WALL_SIZE);
+        }
+    } else {
+        m.create_paths(glm::ivec3(0));
+        m.gen_vertices(MAZE_WALL_SIZE);
+    }
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    if (opts.print)
+        m.print();
 
-    glEnable(GL_DEBUG_OUTPUT);
-    glDebugMessageCallback(opengl_message_callback, nullptr);
-    glViewport(0, 0, WIDTH, HEIGHT);
+    return !opts.save_path || m.save(opts.save_path, opts.save_mesh);
 }
 
 int main(int argc, char** argv) {
-    maze m;
-    m.create_paths(glm::ivec3(0));
-    m.print();
-    m.gen_vertices(10.0f);
+    int64_t start_time = sim_clock();
 
-    SDL_Window* window;
-    SDL_GLContext context;
+    options opts;
+    if (!parse_options(argc, argv, opts))
+        return 1;
 
-    init(window, context);
+    trace_thread_name("main");
+    if (opts.trace_path)
+        trace_enabled = true;
 
-    GLuint program_ids[PROGRAM_COUNT];
-    if (!compile_shaders_and_link_programs(program_ids)) {
-        return 1;
+    // a replay runs in the maze it was recorded in
+    input_log replay;
+    if (opts.replay_path) {
+        if (!replay.load(opts.replay_path))
+            return 1;
+
+        opts.maze_size = replay.size;
+        opts.seed = replay.seed;
     }
 
-    Minimap minimap(WIDTH, HEIGHT);
+    // and a networked game in the server's, only its seed is sent
+    net_client client;
+    if (opts.connect) {
+        net_address server;
+        if (!parse_address(opts.connect, NET_DEFAULT_PORT, server) || !client.connect(server))
+            return 1;
 
+        opts.maze_size = client.maze_size;
+        opts.seed = client.seed;
+        std::printf("joined %s as player %d\n", opts.connect, client.get_id());
+    }
 
-    if (!minimap.create()) 
-        return 1;
+    // the maze is built while the window, the context and the shaders are
+    // set up, only uploading the mesh waits for it
+    maze m(opts.maze_size, opts.seed);
+    std::future<bool> built = std::async(std::launch::async, build_maze, std::ref(m), std::cref(opts));
 
-    // init things
-    m.init_gl();
-    
-    // quad things for minimap
-    GLuint quad_vao;
-    GLuint quad_pos_vbo;
-    GLuint quad_uv_vbo;
-    {
-        GLuint quad_pos_attrib_index = 0;
-        GLuint quad_uv_attrib_index = 1;
-
-        glGenBuffers(1, &quad_pos_vbo);
-        glGenBuffers(1, &quad_uv_vbo);
-        glGenVertexArrays(1, &quad_vao);
-    
-        glBindVertexArray(quad_vao);    
-    
-        // pos bufffer
-        glBindBuffer(GL_ARRAY_BUFFER, quad_pos_vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(quad_pos),
-                     quad_pos,
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(quad_pos_attrib_index, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(quad_pos_attrib_index);
-
-        // uv buffer
-        glBindBuffer(GL_ARRAY_BUFFER, quad_uv_vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(quad_uv),
-                     quad_uv,
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(quad_uv_attrib_index, 2, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(quad_uv_attrib_index);
-    }
-    
-    // arrow vao
-    GLuint arrow_vao;
-    GLuint arrow_pos_vbo;
-    GLuint arrow_color_vbo;
-    {
-    
-        GLuint arrow_pos_attrib_index = 0;
-        GLuint arrow_color_attrib_index = 1;
-
-
-        glGenBuffers(1, &arrow_pos_vbo);
-        glGenBuffers(1, &arrow_color_vbo);
-        glGenVertexArrays(1, &arrow_vao);
-    
-        glBindVertexArray(arrow_vao);   
-    
-        // pos bufffer
-        glBindBuffer(GL_ARRAY_BUFFER, arrow_pos_vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(arrow_pos),
-                     arrow_pos,
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(arrow_pos_attrib_index, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(arrow_pos_attrib_index);
-
-        // uv buffer
-        glBindBuffer(GL_ARRAY_BUFFER, arrow_color_vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(arrow_color),
-                     arrow_color,
-                     GL_STATIC_DRAW);
-        glVertexAttribPointer(
-                arrow_color_attrib_index,
-                3,
-                GL_FLOAT,
-                GL_FALSE,
-                6 * sizeof(float),
-                (void*)(3 * sizeof(float)));
-        
-        glVertexAttribPointer(arrow_color_attrib_index, 3, GL_FLOAT, GL_FALSE, 0, 0);
-        glEnableVertexAttribArray(arrow_color_attrib_index);
+    auto wait_for_maze = [&]() {
+        TRACE_ZONE("wait for maze");
+        if (!built.get())
+            return false;
+
+        if (opts.replay_path && m.get_seed() != replay.seed) {
+            std::fprintf(stderr, "%s was recorded in a maze with seed %u, not %u\n",
+                         opts.replay_path, replay.seed, m.get_seed());
+        }
+
+        if (opts.connect && m.get_seed() != client.seed) {
+            std::fprintf(stderr, "the server plays in a maze with seed %u, not %u\n",
+                         client.seed, m.get_seed());
+        }
+        return true;
+    };
+
+    if (opts.headless) {
+        int result = run_headless(m, opts, opts.replay_path ? &replay : nullptr, opts.connect ? &client : nullptr,
+                                  wait_for_maze);
+        if (opts.trace_path && !trace_dump(opts.trace_path))
+            return 1;
+        return result;
     }
-    
-
-    glm::mat4 proj = glm::perspective(
-            glm::radians(90.0f),
-            (float) WIDTH / HEIGHT,
-            0.1f,
-            100.0f);
-
-    glm::vec3 cam_pos = glm::vec3(0.0f, 0.0f, 3.0f);
-    glm::vec3 cam_up = glm::vec3(0.0f, 1.0f, 0.0f);
-    glm::vec3 cam_front = glm::vec3(0.0f, 0.0f, -1.0f);
-    glm::vec3 cam_right = glm::cross(cam_front, cam_up);
-    glm::mat4 view = glm::lookAt(cam_pos, glm::vec3(0.0f), cam_up);
-    glm::vec3 model_pos = glm::vec3(0.0f);
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), model_pos);
-    glm::mat4 mvp = proj * view * model;
 
-    glm::ivec2 dmouse(0);
+    SDL_Window* window;
+    SDL_GLContext context;
 
-    glUseProgram(program_ids[PROGRAM_MINIMAP]);
-    glUniform1i(glGetUniformLocation(program_ids[PROGRAM_MINIMAP], "color_texture"), 0);
-    glUniform1i(glGetUniformLocation(program_ids[PROGRAM_MINIMAP], "depth_texture"), 1);
-    glUseProgram(program_ids[PROGRAM_BASIC]);
-    GLint mvp_uniform_loc = glGetUniformLocation(program_ids[PROGRAM_BASIC], "mvp");
-    GLint cam_pos_uniform_loc = glGetUniformLocation(
-                                                    program_ids[PROGRAM_BASIC],
-                                                    "cam_pos");
+    init(window, context, opts.present);
 
-    glLineWidth(2.0f);
+    renderer r;
+    if (!r.init() || !wait_for_maze())
+        return 1;
 
-    long long frame_count = 0;
+    r.show_overlay = opts.overlay;
+    r.frame_budget_ms = opts.frame_budget_ms;
+    r.occlusion_culling = opts.occlusion;
+    std::vector<point_light> torches;
+    place_torches(m, opts.lights, m.get_seed(), torches);
+    r.point_lights = torches;
 
-    float speed = 0.1f;
-    float sensitivity = 0.005f;
+    m.init_gl();
 
-    input_controller icontroller;
+    glm::ivec2 dmouse(0);
+    // everything pushed to the simulation per player, it reports what it
+    // applied
+    glm::ivec2 mouse_sent[SIM_MAX_PLAYERS] = {};
+    gamepad pads[SIM_MAX_PLAYERS - 1];
+
+    present_stats stats;
+
+    // input, movement and the camera live on the simulation thread, this one
+    // only forwards input and draws the latest snapshot it published.
+    input_log recording;
+    recording.seed = m.get_seed();
+    recording.size = m.get_size();
+
+    simulation sim;
+    sim.players = opts.players;
+    if (opts.record_path)
+        sim.recording = &recording;
+    if (opts.replay_path)
+        sim.replay = &replay;
+    if (opts.connect)
+        sim.net = &client;
+    sim.start();
+
+    // a frame that would come out like the last one isn't drawn, the loop
+    // sleeps on the event queue instead. Uncapped runs measure throughput.
+    bool idle_allowed = opts.idle && opts.present != PRESENT_UNCAPPED;
+    bool idle = false;
+    int idle_wait_ms = IDLE_WAIT_MS;
+    bool redraw = true;
+    view_camera drawn[SIM_MAX_PLAYERS] = {};
+    std::vector<point_light> drawn_lights;
 
     // start render loop
     bool quit = false;
+    bool first_frame = true;
+    int64_t last_frame_start = 0;
     while(!quit) {
+        TRACE_ZONE("frame");
+
         SDL_Event event;
-        while(SDL_PollEvent(&event)) {
-            quit = process_event(event, icontroller);
+        bool have_event;
+        if (idle) {
+            TRACE_ZONE("idle");
+            have_event = SDL_WaitEventTimeout(&event, idle_wait_ms);
+        } else {
+            have_event = SDL_PollEvent(&event);
+        }
+
+        // the frame time is from one drawn frame to the next, an idle wait
+        // isn't one
+        int64_t frame_start = sim_clock();
+        float dt = last_frame_start && !idle ? (frame_start - last_frame_start) * 1e-9f : 0.0f;
+        if (dt > 0.0f)
+            r.profile.add(TIMING_FRAME, dt * 1e3f);
+        last_frame_start = frame_start;
+
+        for (; have_event; have_event = SDL_PollEvent(&event)) {
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F3)
+                r.show_overlay = !r.show_overlay;
+
+            if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F4 &&
+                opts.trace_path && trace_dump(opts.trace_path)) {
+                std::printf("trace written to %s\n", opts.trace_path);
+            }
+
+            quit = process_event(event, sim) || quit;
+            process_gamepad_event(event, pads, opts.players - 1);
+
+            // input, the window shown again, the overlay: any of them
+            redraw = true;
+        }
+
+        if (sim.frames.fetch())
+            r.profile.add(TIMING_SIM, sim.frames.front().tick_time * 1e-6f);
+        const frame_state& frame = sim.frames.front();
+
+        if (frame.replay_done)
+            quit = true;
+
+        if (frame.disconnected) {
+            std::fprintf(stderr, "ERROR: Net: the server stopped answering\n");
+            quit = true;
         }
-        
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        glClearColor(1.0, 0.3, 0.3, 1.0);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-        glUseProgram(program_ids[PROGRAM_BASIC]);
-
-        // send mvp
-        glUniformMatrix4fv(
-                mvp_uniform_loc,
-                1,
-                GL_FALSE,
-                glm::value_ptr(mvp));
-
-        // send cam_pos
-        glUniform3fv(
-                cam_pos_uniform_loc,
-                1,
-                glm::value_ptr(cam_pos));
-
-        // draw maze
-        m.render();
-        
-        // draw minimap
-        minimap.render(quad_vao, program_ids, mvp_uniform_loc, m);
-
-        // draw arrow in perspective, but not in viewport.
-        glDisable(GL_DEPTH_TEST);
-        glBindVertexArray(arrow_vao);
-        glUseProgram(program_ids[PROGRAM_BASIC]);
-
-        glm::mat4 arrow_shift = glm::translate(glm::vec3(0.8f,-0.8f, 0.0f));
-        glm::mat4 arrow_model = glm::mat4(1.0f);
-        glm::mat4 arrow_view = glm::lookAt(
-                -5.0f * cam_front,
-                glm::vec3(0.0f, 0.0f, 0.0f),
-                cam_up);
-
-        glm::mat4 arrow_mvp = arrow_shift * proj * arrow_view * arrow_model;
-        glUniformMatrix4fv(
-                mvp_uniform_loc,
-                1,
-                GL_FALSE,
-                glm::value_ptr(arrow_mvp));
-        glDrawArrays(GL_LINE_STRIP, 0, 5);
-
-        arrow_model = glm::rotate(arrow_model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        arrow_mvp = arrow_shift * proj * arrow_view * arrow_model;
-        glUniformMatrix4fv(
-                mvp_uniform_loc,
-                1,
-                GL_FALSE,
-                glm::value_ptr(arrow_mvp));
-        glDrawArrays(GL_LINE_STRIP, 0, 5);
-
-        arrow_model = glm::rotate(arrow_model, glm::radians(90.0f), glm::vec3(0.0f,-1.0f, 0.0f));
-        arrow_mvp = arrow_shift * proj * arrow_view * arrow_model;
-        glUniformMatrix4fv(
-                mvp_uniform_loc,
-                1,
-                GL_FALSE,
-                glm::value_ptr(arrow_mvp));
-        glDrawArrays(GL_LINE_STRIP, 0, 5);
-        glEnable(GL_DEPTH_TEST);
-
-
-        SDL_GL_SwapWindow(window);
-
-        if (icontroller.is_active(FORWARD)) {
-            cam_pos += speed * cam_front;
+
+        if (opts.connect) {
+            r.point_lights = torches;
+            place_player_lights(frame.remote_pos, frame.remote_players, m.get_wall_size(), r.point_lights);
+        }
+
+        if (m.stream(frame.player[0].cam_pos))
+            redraw = true;
+
+        // sample the mouse as late as possible, right before the view is
+        // built, and apply what the simulation hasn't seen yet ourselves.
+        SDL_GetRelativeMouseState(&dmouse.x, &dmouse.y);
+        if (opts.replay_path) {
+            // the mouse is in the log, nothing is pending
+            for (int i = 0; i < opts.players; i++)
+                mouse_sent[i] = frame.player[i].mouse_consumed;
+        } else {
+            if (dmouse != glm::ivec2(0) &&
+                sim.inputs.push({ INPUT_MOUSE, 0, (int16_t) dmouse.x, (int16_t) dmouse.y, 0 })) {
+                mouse_sent[0] += dmouse;
+            }
+
+            poll_gamepads(pads, opts.players - 1, dt, sim, mouse_sent);
         }
-        
-        if (icontroller.is_active(BACKWARD)) {
-            cam_pos -= speed * cam_front;
+
+        int64_t input_time = sim_clock();
+        view_camera cameras[SIM_MAX_PLAYERS];
+        // the simulation caught up with every input and the players stopped,
+        // only an event moves them again
+        bool settled = !frame.input_held;
+        for (int i = 0; i < opts.players; i++) {
+            camera_at(frame, i, input_time, mouse_sent[i],
+                      cameras[i].pos, cameras[i].front, cameras[i].up);
+
+            redraw = redraw || cameras[i].pos != drawn[i].pos ||
+                     cameras[i].front != drawn[i].front || cameras[i].up != drawn[i].up;
+            settled = settled && mouse_sent[i] == frame.player[i].mouse_consumed &&
+                      frame.player[i].prev_cam_pos == frame.player[i].cam_pos;
         }
-        
-        if (icontroller.is_active(RIGHT)) {
-            cam_pos += speed * cam_right;
+
+        if (r.point_lights.size() != drawn_lights.size() ||
+            !std::equal(r.point_lights.begin(), r.point_lights.end(), drawn_lights.begin(),
+                        [](const point_light& a, const point_light& b) { return a.pos == b.pos; })) {
+            redraw = true;
         }
-        
-        if (icontroller.is_active(LEFT)) {
-            cam_pos -= speed * cam_right;
+
+        // nothing is presented, the last frame stays on the screen. Replays,
+        // networked games and streaming change it without any event, they
+        // are looked at again after a tick.
+        idle = idle_allowed && !redraw;
+        if (idle) {
+            bool quiet = settled && !opts.replay_path && !opts.connect && !m.stream_pending();
+            idle_wait_ms = quiet ? IDLE_WAIT_MS : 1000 / SIM_TICK_RATE;
+            continue;
         }
-        
-        if (icontroller.is_active(UP)) {
-            cam_pos += speed * cam_up;
+
+        r.draw(m, cameras, opts.players);
+        std::copy(cameras, cameras + opts.players, drawn);
+        drawn_lights = r.point_lights;
+        redraw = false;
+
+        int64_t swap_start = sim_clock();
+        {
+            TRACE_ZONE("swap");
+            SDL_GL_SwapWindow(window);
         }
-        
-        if (icontroller.is_active(DOWN)) {
-            cam_pos -= speed * cam_up;
+        int64_t now = sim_clock();
+        r.profile.add(TIMING_SWAP, (now - swap_start) * 1e-6f);
+
+        if (opts.stats) {
+            if (first_frame)
+                std::printf("first frame %.1f ms after start\n", (now - start_time) * 1e-6);
+            stats.presented(input_time, now);
+            stats.report(now);
         }
+        first_frame = false;
+    }
 
-        icontroller.reload();
-        SDL_GetRelativeMouseState(&dmouse.x, &dmouse.y);
+    sim.stop();
+    client.disconnect();
 
-        cam_right = glm::rotate(glm::rotate(cam_right, sensitivity * -dmouse.x, cam_up), sensitivity * -dmouse.y, cam_right);
-        cam_front = glm::rotate(glm::rotate(cam_front, sensitivity * -dmouse.x, cam_up), sensitivity * -dmouse.y, cam_right);
-        cam_up = glm::cross(cam_right, cam_front);
-        
-        view = glm::lookAt(
-                cam_pos,
-                cam_front + cam_pos,
-                cam_up);
-        mvp = proj * view * model;
-
-        frame_count++;
+    for (gamepad& pad : pads) {
+        if (pad.controller)
+            SDL_GameControllerClose(pad.controller);
     }
 
-    glDeleteProgram(program_ids[PROGRAM_BASIC]);
+    if (opts.trace_path)
+        trace_dump(opts.trace_path);
+
     SDL_GL_DeleteContext(context);
     SDL_DestroyWindow(window);
     SDL_Quit();
+
+    if (opts.record_path && !recording.save(opts.record_path))
+        return 1;
+
     return 0;
 }
 
-void opengl_message_callback(
-        GLenum source,
-        GLenum type,
-        GLuint id,
-        GLenum severity,
-        GLsizei length,
-        GLchar const* message,
-        void const* user_param)
-{
-    auto const src_str = [source]() {
-        switch (source)
-        {
-        case GL_DEBUG_SOURCE_API:
-            return "API";
-        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
-            return "WINDOW SYSTEM";
-        case GL_DEBUG_SOURCE_SHADER_COMPILER:
-            return "SHADER COMPILER";
-        case GL_DEBUG_SOURCE_THIRD_PARTY:
-            return "THIRD PARTY";
-        case GL_DEBUG_SOURCE_APPLICATION:
-            return "APPLICATION";
-        case GL_DEBUG_SOURCE_OTHER:
-            return "OTHER";
-        default:
-            return "what??";
-        }
-    }();
-
-    auto const type_str = [type]() {
-        switch (type)
-        {
-        case GL_DEBUG_TYPE_ERROR:
-            return "ERROR";
-        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
-            return "DEPRECATED_BEHAVIOR";
-        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
-            return "UNDEFINED_BEHAVIOR";
-        case GL_DEBUG_TYPE_PORTABILITY:
-            return "PORTABILITY";
-        case GL_DEBUG_TYPE_PERFORMANCE:
-            return "PERFORMANCE";
-        case GL_DEBUG_TYPE_MARKER:
-            return "MARKER";
-        case GL_DEBUG_TYPE_OTHER:
-            return "OTHER";
-        default:
-            return "what??";
-        }
-    }();
-
-    auto const severity_str = [severity] () {
-        switch (severity) {
-        case GL_DEBUG_SEVERITY_NOTIFICATION:
-            return "NOTIFICATION";
-        case GL_DEBUG_SEVERITY_LOW:
-            return "LOW";
-        case GL_DEBUG_SEVERITY_MEDIUM:
-            return "MEDIUM";
-        case GL_DEBUG_SEVERITY_HIGH:
-            return "HIGH";
-        default:
-            return "what??";
-        }
-    }();
-
-    std::fprintf(
-            stderr,
-            "OPENGL CALLBACK: %s, %s, %s, %d, %s\n",
-            src_str,
-            type_str,
-            severity_str,
-            id,
-            message);
+static void send_key(simulation& sim, input_event_type type, motions m, uint8_t player = 0) {
+    sim.inputs.push({ (uint8_t) type, (uint8_t) m, 0, 0, player });
 }
 
-bool process_event(SDL_Event event, input_controller& icontroller) {
+bool process_event(SDL_Event event, simulation& sim) {
+    TRACE_ZONE("process_event");
+
     switch (event.type) {
     case SDL_QUIT:
         return true;
@@ -461,44 +389,44 @@ bool process_event(SDL_Event event, input_controller& icontroller) {
         case SDLK_ESCAPE:
             return true;
         case SDLK_w:
-            icontroller.key_down(FORWARD);
+            send_key(sim, INPUT_KEY_DOWN, FORWARD);
             break;
         case SDLK_a:
-            icontroller.key_down(LEFT);
+            send_key(sim, INPUT_KEY_DOWN, LEFT);
             break;
         case SDLK_s:
-            icontroller.key_down(BACKWARD);
+            send_key(sim, INPUT_KEY_DOWN, BACKWARD);
             break;
         case SDLK_d:
-            icontroller.key_down(RIGHT);
+            send_key(sim, INPUT_KEY_DOWN, RIGHT);
             break;
         case SDLK_SPACE:
-            icontroller.key_down(UP);
+            send_key(sim, INPUT_KEY_DOWN, UP);
             break;
         case SDLK_LSHIFT:
-            icontroller.key_down(DOWN);
+            send_key(sim, INPUT_KEY_DOWN, DOWN);
             break;
         }
         break;
     case SDL_KEYUP:
         switch (event.key.keysym.sym) {
         case SDLK_w:
-            icontroller.key_up(FORWARD);
+            send_key(sim, INPUT_KEY_UP, FORWARD);
             break;
         case SDLK_a:
-            icontroller.key_up(LEFT);
+            send_key(sim, INPUT_KEY_UP, LEFT);
             break;
         case SDLK_s:
-            icontroller.key_up(BACKWARD);
+            send_key(sim, INPUT_KEY_UP, BACKWARD);
             break;
         case SDLK_d:
-            icontroller.key_up(RIGHT);
+            send_key(sim, INPUT_KEY_UP, RIGHT);
             break;
         case SDLK_SPACE:
-            icontroller.key_up(UP);
+            send_key(sim, INPUT_KEY_UP, UP);
             break;
         case SDLK_LSHIFT:
-            icontroller.key_up(DOWN);
+            send_key(sim, INPUT_KEY_UP, DOWN);
             break;
         }
         break;
@@ -506,3 +434,74 @@ bool process_event(SDL_Event event, input_controller& icontroller) {
 
     return false;
 }
+
+// Controllers take the first free pad as they are plugged in, a player that
+// loses theirs gets the next one.
+void process_gamepad_event(SDL_Event event, gamepad* pads, int count) {
+    if (event.type == SDL_CONTROLLERDEVICEADDED) {
+        for (int i = 0; i < count; i++) {
+            if (pads[i].controller)
+                continue;
+
+            pads[i].controller = SDL_GameControllerOpen(event.cdevice.which);
+            if (!pads[i].controller)
+                std::fprintf(stderr, "ERROR: Input: could not open controller %d: %s\n", event.cdevice.which, SDL_GetError());
+            break;
+        }
+    } else if (event.type == SDL_CONTROLLERDEVICEREMOVED) {
+        for (int i = 0; i < count; i++) {
+            if (pads[i].controller && !SDL_GameControllerGetAttached(pads[i].controller)) {
+                SDL_GameControllerClose(pads[i].controller);
+                pads[i].controller = nullptr;
+            }
+        }
+    }
+}
+
+// The left stick and the shoulders become the keys of the keyboard player,
+// the right stick the mouse. Pad i plays player i + 1.
+void poll_gamepads(gamepad* pads, int count, float dt, simulation& sim, glm::ivec2* mouse_sent) {
+    for (int i = 0; i < count; i++) {
+        gamepad& pad = pads[i];
+        uint8_t player = (uint8_t) (i + 1);
+
+        bool want[NUM_MOTIONS] = {};
+        if (pad.controller) {
+            int x = SDL_GameControllerGetAxis(pad.controller, SDL_CONTROLLER_AXIS_LEFTX);
+            int y = SDL_GameControllerGetAxis(pad.controller, SDL_CONTROLLER_AXIS_LEFTY);
+            want[FORWARD] = y < -PAD_DEAD_ZONE;
+            want[BACKWARD] = y > PAD_DEAD_ZONE;
+            want[RIGHT] = x > PAD_DEAD_ZONE;
+            want[LEFT] = x < -PAD_DEAD_ZONE;
+            want[UP] = SDL_GameControllerGetButton(pad.controller, SDL_CONTROLLER_BUTTON_RIGHTSHOULDER);
+            want[DOWN] = SDL_GameControllerGetButton(pad.controller, SDL_CONTROLLER_BUTTON_LEFTSHOULDER);
+        }
+
+        // an unplugged pad lets go of everything
+        for (int m = 0; m < NUM_MOTIONS; m++) {
+            if (want[m] != pad.held[m]) {
+                send_key(sim, want[m] ? INPUT_KEY_DOWN : INPUT_KEY_UP, (motions) m, player);
+                pad.held[m] = want[m];
+            }
+        }
+
+        if (!pad.controller)
+            continue;
+
+        glm::ivec2 stick(
+                SDL_GameControllerGetAxis(pad.controller, SDL_CONTROLLER_AXIS_RIGHTX),
+                SDL_GameControllerGetAxis(pad.controller, SDL_CONTROLLER_AXIS_RIGHTY));
+        if (std::abs(stick.x) < PAD_DEAD_ZONE)
+            stick.x = 0;
+        if (std::abs(stick.y) < PAD_DEAD_ZONE)
+            stick.y = 0;
+
+        pad.look_rest += glm::vec2(stick) / 32767.0f * PAD_LOOK_SPEED * dt;
+        glm::ivec2 look = glm::ivec2(pad.look_rest);
+        if (look != glm::ivec2(0) &&
+            sim.inputs.push({ INPUT_MOUSE, 0, (int16_t) look.x, (int16_t) look.y, player })) {
+            pad.look_rest -= glm::vec2(look);
+            mouse_sent[player] += look;
+        }
+    }
+}
@@ -0,0 +1,159 @@
+#include "materials.h"
+#include "trace.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+enum material_names { MATERIAL_BRICKS, MATERIAL_PLASTER, MATERIAL_TILES, MATERIAL_PLANKS, MATERIAL_COUNT };
+
+static_assert(MATERIAL_COUNT == MAZE_MATERIALS, "the maze uses more materials than there are made");
+
+static uint32_t mix_bits(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+// 0 to 1 at the lattice point (x, y), another set of them for each seed.
+static float lattice(int x, int y, uint32_t seed) {
+    uint32_t h = mix_bits(seed * 0x9e3779b9u ^ mix_bits((uint32_t) x * 73856093u ^ (uint32_t) y * 19349663u));
+    return h / 4294967295.0f;
+}
+
+// Value noise over a material (u and v from 0 to 1) of period x and y
+// lattice cells, so it wraps where the texture repeats.
+static float value_noise(float u, float v, int period_x, int period_y, uint32_t seed) {
+    float x = u * period_x;
+    float y = v * period_y;
+    int x0 = (int) std::floor(x);
+    int y0 = (int) std::floor(y);
+    // smoothed, so the lattice doesn't show
+    float fx = x - x0;
+    float fy = y - y0;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+
+    int x1 = (x0 + 1) % period_x;
+    int y1 = (y0 + 1) % period_y;
+    x0 %= period_x;
+    y0 %= period_y;
+
+    float bottom = glm::mix(lattice(x0, y0, seed), lattice(x1, y0, seed), fx);
+    float top = glm::mix(lattice(x0, y1, seed), lattice(x1, y1, seed), fx);
+    return glm::mix(bottom, top, fy);
+}
+
+// a few octaves of value noise, the finer ones weigh less. 0 to 1.
+static float fractal_noise(float u, float v, uint32_t seed) {
+    float sum = 0.0f;
+    float total = 0.0f;
+    float weight = 0.5f;
+    for (int period = 4; period <= 32; period *= 2) {
+        sum += weight * value_noise(u, v, period, period, seed + period);
+        total += weight;
+        weight *= 0.5f;
+    }
+    return sum / total;
+}
+
+// Albedo of the texel (x, y) of a material. t is up along a vertical wall.
+static glm::vec3 material_texel(int material, int x, int y) {
+    float u = (x + 0.5f) / MATERIAL_SIZE;
+    float v = (y + 0.5f) / MATERIAL_SIZE;
+    float grit = fractal_noise(u, v, material) - 0.5f;
+
+    switch (material) {
+    case MATERIAL_BRICKS: {
+        // eight rows of four bricks, every other row half a brick over
+        const int brick_w = MATERIAL_SIZE / 4;
+        const int brick_h = MATERIAL_SIZE / 8;
+        int row = y / brick_h;
+        int bx = (x + (row & 1) * brick_w / 2) % MATERIAL_SIZE;
+        if (y % brick_h < 2 || bx % brick_w < 2)
+            return glm::vec3(0.5f + 0.1f * grit);
+
+        float shade = 0.72f + 0.12f * (lattice(bx / brick_w, row, material) - 0.5f) + 0.15f * grit;
+        return shade * glm::vec3(1.0f, 0.8f, 0.7f);
+    }
+    case MATERIAL_PLASTER:
+        return (0.82f + 0.2f * grit) * glm::vec3(0.97f, 0.95f, 0.9f);
+    case MATERIAL_TILES: {
+        const int tile = MATERIAL_SIZE / 4;
+        if (x % tile < 2 || y % tile < 2)
+            return glm::vec3(0.45f + 0.05f * grit);
+
+        float shade = 0.85f + 0.08f * (lattice(x / tile, y / tile, material) - 0.5f) + 0.06f * grit;
+        return shade * glm::vec3(0.8f, 0.88f, 1.0f);
+    }
+    default: {
+        // upright planks, the grain runs along them
+        const int plank = MATERIAL_SIZE / 8;
+        if (x % plank == 0)
+            return glm::vec3(0.35f);
+
+        float grain = value_noise(u, v, MATERIAL_SIZE / 2, 4, material + x / plank) - 0.5f;
+        float shade = 0.6f + 0.1f * (lattice(x / plank, 0, material) - 0.5f) + 0.15f * grain + 0.05f * grit;
+        return shade * glm::vec3(1.0f, 0.78f, 0.55f);
+    }
+    }
+}
+
+bool material_array::create() {
+    TRACE_ZONE("materials create");
+
+    // down to 1x1, the far walls of a chunk are a texel or less
+    int levels = std::bit_width((unsigned) MATERIAL_SIZE);
+
+    glGenTextures(1, &texture);
+    glActiveTexture(GL_TEXTURE0 + MATERIAL_TEXTURE_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, MATERIAL_SIZE, MATERIAL_SIZE, MAZE_MATERIALS);
+
+    std::vector<uint8_t> texels((size_t) MATERIAL_SIZE * MATERIAL_SIZE * 4);
+    for (int layer = 0; layer < MAZE_MATERIALS; layer++) {
+        uint8_t* texel = texels.data();
+        for (int y = 0; y < MATERIAL_SIZE; y++) {
+            for (int x = 0; x < MATERIAL_SIZE; x++, texel += 4) {
+                glm::vec3 albedo = glm::clamp(material_texel(layer, x, y), 0.0f, 1.0f);
+                for (int c = 0; c < 3; c++)
+                    texel[c] = (uint8_t) std::lround(albedo[c] * 255.0f);
+                texel[3] = 255;
+            }
+        }
+
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, MATERIAL_SIZE, MATERIAL_SIZE, 1,
+                        GL_RGBA, GL_UNSIGNED_BYTE, texels.data());
+    }
+
+    glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+
+    // walls are mostly seen at a slant down the corridors
+    if (GLEW_EXT_texture_filter_anisotropic) {
+        float most = 1.0f;
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &most);
+        glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, std::min(most, MATERIAL_ANISOTROPY));
+    }
+
+    glActiveTexture(GL_TEXTURE0);
+
+    if (glGetError() != GL_NO_ERROR) {
+        std::fprintf(stderr, "ERROR: Materials: could not create the material texture array\n");
+        return false;
+    }
+
+    // the mip chain adds a third
+    gpu_memory.set((size_t) MATERIAL_SIZE * MATERIAL_SIZE * 4 * MAZE_MATERIALS * 4 / 3);
+    return true;
+}
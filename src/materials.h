@@ -0,0 +1,31 @@
+#ifndef IT_MATERIALS_H
+#define IT_MATERIALS_H
+
+#include <GL/glew.h>
+
+#include "maze.h"
+#include "memory.h"
+
+// texels along each side of a material, a wall cell shows one whole.
+#define MATERIAL_SIZE 128
+// the unit the array stays bound to, the minimap and the overlay use the
+// ones below it.
+#define MATERIAL_TEXTURE_UNIT 2
+// most samples anisotropic filtering takes, where the driver has it.
+#define MATERIAL_ANISOTROPY 8.0f
+
+/**
+ * @brief The wall materials, a mipmapped texture array with a layer per
+ * material (MAZE_MATERIALS of them). There are no image assets, they are
+ * made up at startup. Bound once, so the walls of a chunk are one draw
+ * whatever their materials.
+ */
+class material_array {
+    GLuint texture = 0;
+    memory_account gpu_memory{MEMORY_GPU_TEXTURES};
+
+public:
+    bool create();
+};
+
+#endif
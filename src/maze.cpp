@@ -1,22 +1,24 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/rotate_vector.hpp>
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
 #include <vector>
 #include <random>
 
+#include "jobs.h"
 #include "maze.h"
+#include "trace.h"
 
-#define XPOSITIVE 0x01
-#define XNEGATIVE 0x02
-#define YPOSITIVE 0x04
-#define YNEGATIVE 0x08
-#define ZPOSITIVE 0x10
-#define ZNEGATIVE 0x20
+#ifndef IT_NO_GL
+#include "maze_stream.h"
+#endif
 
-std::random_device rd;
-std::mt19937 rng(rd());
-
-static void append_wall(std::vector<glm::vec3> &vertices, int d, float wall_size, int x, int y, int z);
+static void append_wall(std::vector<maze_vertex> &vertices, int d, float wall_size, int x, int y, int z, uint32_t material);
 	
 uint32_t opposite(uint32_t d) {
 	switch (d) {
@@ -87,161 +89,610 @@ static glm::vec3 quad_vector_to_rotate(uint32_t d) {
 	}
 }
 
-template <typename T>
-void shuffle(std::vector<T>& v) {
-	int n = v.size();
-	for (int i = 0; i <= n - 2; i++) {
-		std::uniform_int_distribution<uint32_t> dist(i, n - 1);
-		int j = dist(rng);
-		auto tmp = v[i];
-		v[i] = v[j];
-		v[j] = tmp;
-	}
+maze::maze(glm::ivec3 size, uint32_t seed) :
+	size(size),
+	chunks((size + (MAZE_CHUNK_SIZE - 1)) / MAZE_CHUNK_SIZE),
+	seed(seed ? seed : std::random_device()()),
+	cell_storage((size_t)chunks.x * chunks.y * chunks.z * MAZE_CHUNK_CELLS, 0) {
+	cells = cell_storage.data();
+	cells_memory.set(cell_storage.size());
+}
+
+// only what is allocated here, not what is mapped from a file.
+void maze::account_mesh() {
+	mesh_memory.set(vertices.capacity() * sizeof(maze_vertex) + chunk_table.capacity() * sizeof(maze_chunk));
 }
 
-maze::maze() : data{0} {}
+maze::~maze() = default;
 
+// Iterative recursive backtracker. The explicit stack keeps big mazes from
+// running out of call stack, positions are packed to keep it small.
 void maze::create_paths(glm::ivec3 start) {
-	std::vector dirs{ XPOSITIVE, XNEGATIVE, YPOSITIVE, YNEGATIVE, ZPOSITIVE, ZNEGATIVE };
+	TRACE_ZONE("maze create_paths");
+
+	const uint32_t dirs[] = { XPOSITIVE, XNEGATIVE, YPOSITIVE, YNEGATIVE, ZPOSITIVE, ZNEGATIVE };
+
+	auto pack = [this](glm::ivec3 p) {
+		return (uint32_t)((p.z * size.y + p.y) * size.x + p.x);
+	};
+	auto unpack = [this](uint32_t i) {
+		return glm::ivec3(i % size.x, (i / size.x) % size.y, i / size.x / size.y);
+	};
 
-	shuffle(dirs);
+	std::mt19937 rng(seed);
+	std::vector<uint32_t> stack;
+	stack.push_back(pack(start));
 
-	for (int i = 0; i < dirs.size(); i++) {
-		auto next = start + direction(dirs[i]);
-		if (in_bounds(next) && !data[next.x][next.y][next.z]) {
-			data[start.x][start.y][start.z] |= dirs[i];
-			data[next.x][next.y][next.z] |= opposite(dirs[i]);
+	while (!stack.empty()) {
+		glm::ivec3 current = unpack(stack.back());
 
-			create_paths(next);
+		uint32_t candidates[6];
+		int n = 0;
+		for (uint32_t d : dirs) {
+			auto next = current + direction(d);
+			if (in_bounds(next) && !cells[index(next)])
+				candidates[n++] = d;
 		}
+
+		if (!n) {
+			stack.pop_back();
+			continue;
+		}
+
+		uint32_t d = candidates[std::uniform_int_distribution<int>(0, n - 1)(rng)];
+		auto next = current + direction(d);
+		cells[index(current)] |= d;
+		cells[index(next)] |= opposite(d);
+		stack.push_back(pack(next));
 	}
 }
 
 bool maze::in_bounds(glm::ivec3 p) const {
-	return p.x >= 0 && p.x < MAZE_WIDTH &&
-		   p.y >= 0 && p.y < MAZE_HEIGHT &&
-		   p.z >= 0 && p.z < MAZE_LENGTH;
+	return p.x >= 0 && p.x < size.x &&
+		   p.y >= 0 && p.y < size.y &&
+		   p.z >= 0 && p.z < size.z;
 }
 
-void maze::gen_vertices(float wall_size) {
-	for (int z = 0; z < MAZE_LENGTH; z++) {
-		for (int y = 0; y < MAZE_HEIGHT; y++) {
-			for (int x = 0; x < MAZE_WIDTH; x++) {
+void maze::gather_apron(glm::ivec3 chunk, uint8_t* apron) const {
+	glm::ivec3 lo = chunk * MAZE_CHUNK_SIZE;
+	int inside = glm::min(MAZE_CHUNK_SIZE, size.x - lo.x);
+
+	for (int z = -1; z <= MAZE_CHUNK_SIZE; z++) {
+		for (int y = -1; y <= MAZE_CHUNK_SIZE; y++, apron += MAZE_APRON_SIZE) {
+			glm::ivec3 p = lo + glm::ivec3(0, y, z);
+			if (!in_bounds(p)) {
+				std::memset(apron, MAZE_APRON_OUTSIDE, MAZE_APRON_SIZE);
+				continue;
+			}
+
+			// the row of the chunk is contiguous in its brick, only the
+			// two ends come from the neighbours
+			std::memcpy(apron + 1, &cells[index(p)], inside);
+			std::memset(apron + 1 + inside, MAZE_APRON_OUTSIDE, MAZE_APRON_SIZE - 1 - inside);
+			apron[0] = lo.x > 0 ? cell(p - glm::ivec3(1, 0, 0)) : MAZE_APRON_OUTSIDE;
+			if (inside == MAZE_CHUNK_SIZE && lo.x + MAZE_CHUNK_SIZE < size.x)
+				apron[MAZE_APRON_SIZE - 1] = cell(p + glm::ivec3(MAZE_CHUNK_SIZE, 0, 0));
+		}
+	}
+}
+
+// Material of the wall of the cell p facing d, from the region of the cell on
+// its negative side so both cells it is between agree on it.
+static uint32_t wall_material(glm::ivec3 p, uint32_t d) {
+	glm::ivec3 c = p + glm::min(direction(d), glm::ivec3(0));
+	uint32_t h = (uint32_t)(c.x >> MAZE_MATERIAL_SHIFT) * 73856093u ^
+	             (uint32_t)(c.y >> MAZE_MATERIAL_SHIFT) * 19349663u ^
+	             (uint32_t)(c.z >> MAZE_MATERIAL_SHIFT) * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return h % MAZE_MATERIALS;
+}
+
+// Appends one quad facing d covering the walls of the cells from a to b
+// (inclusive), a and b only differ on the two axes along the wall.
+static void append_rect(std::vector<maze_vertex> &vertices, uint32_t d, float wall_size, glm::ivec3 a, glm::ivec3 b, uint32_t material) {
+	glm::ivec3 dir = direction(d);
+	glm::vec3 normal = glm::abs(glm::vec3(dir));
+	int n = dir.x ? 0 : dir.y ? 1 : 2;
+	int u = (n + 1) % 3;
+	int v = (n + 2) % 3;
+
+	// the box around the cells, flattened onto the wall plane
+	glm::vec3 lo = glm::vec3(a) - 0.5f;
+	glm::vec3 hi = glm::vec3(b) + 0.5f;
+	lo[n] = a[n] + 0.5f * dir[n];
+	hi[n] = lo[n];
+
+	glm::vec3 c00 = lo;
+	glm::vec3 c11 = hi;
+	glm::vec3 c10 = lo;
+	glm::vec3 c01 = lo;
+	c10[u] = hi[u];
+	c01[v] = hi[v];
+
+	const glm::vec3 quad[] = { c11, c01, c10, c00, c10, c01 };
+	for (const glm::vec3& corner : quad) {
+		vertices.push_back({ wall_size * corner, normal, glm::vec2(1.0f), material });
+	}
+}
+
+static void chunk_cell_range(glm::ivec3 chunk, glm::ivec3 size, glm::ivec3& lo, glm::ivec3& hi) {
+	lo = chunk * MAZE_CHUNK_SIZE;
+	hi = glm::min(lo + MAZE_CHUNK_SIZE, size);
+}
+
+// index in the apron of the chunk starting at lo of the cell p.
+static int apron_index(glm::ivec3 lo, glm::ivec3 p) {
+	glm::ivec3 l = p - lo + 1;
+	return (l.z * MAZE_APRON_SIZE + l.y) * MAZE_APRON_SIZE + l.x;
+}
+
+static uint8_t apron_cell(const uint8_t* apron, glm::ivec3 lo, glm::ivec3 p) {
+	return apron[apron_index(lo, p)];
+}
 
-				if (!(data[x][y][z] & XNEGATIVE)) {
-					append_wall(vertices, XNEGATIVE, wall_size, x, y, z);
+static bool has_wall(uint8_t c, uint32_t d) {
+	return !(c & MAZE_APRON_OUTSIDE) && !(c & d);
+}
+
+// apron index steps along x, y and z.
+static const int apron_stride[3] = { 1, MAZE_APRON_SIZE, MAZE_APRON_SIZE * MAZE_APRON_SIZE };
+
+// the negative and positive direction along x, y and z.
+static const uint32_t axis_dirs[3][2] = {
+	{ XNEGATIVE, XPOSITIVE }, { YNEGATIVE, YPOSITIVE }, { ZNEGATIVE, ZPOSITIVE },
+};
+
+// Occlusion of the corner of a wall seen from inside the apron cell c, su and
+// sv point from the middle of the wall to the corner. The two walls of the
+// cell along the corner's edges each darken it, a wall of a diagonal
+// neighbour touching the corner does too, a corner between two walls is
+// darkest. Branchless, the cells are random enough to defeat the predictor;
+// the neighbours read are always inside the apron.
+static float corner_ao(const uint8_t* c, int u, int v, int su, int sv) {
+	uint32_t du = axis_dirs[u][su > 0];
+	uint32_t dv = axis_dirs[v][sv > 0];
+
+	int side_u = has_wall(*c, du);
+	int side_v = has_wall(*c, dv);
+	int corner = (!side_u & has_wall(c[su * apron_stride[u]], dv))
+		| (!side_v & has_wall(c[sv * apron_stride[v]], du));
+	int level = side_u + side_v + (corner | (side_u & side_v));
+
+	// nothing is seen from outside of the maze
+	level *= !(*c & MAZE_APRON_OUTSIDE);
+	return 1.0f - MAZE_AO_STEP * level;
+}
+
+// Bakes the ao of both sides into the six vertices of the wall cell p emitted
+// facing d.
+static void bake_wall_ao(const uint8_t* apron, glm::ivec3 lo, glm::ivec3 p, uint32_t d, float wall_size, maze_vertex* wall) {
+	glm::ivec3 dir = direction(d);
+	int n = dir.x ? 0 : dir.y ? 1 : 2;
+	int u = (n + 1) % 3;
+	int v = (n + 2) % 3;
+
+	// the cells on either side of the wall
+	const uint8_t* negative = &apron[apron_index(lo, p + glm::min(dir, glm::ivec3(0)))];
+	const uint8_t* positive = negative + apron_stride[n];
+
+	// the four corners, (-u -v) (+u -v) (-u +v) (+u +v)
+	glm::vec2 corners[4];
+	for (int i = 0; i < 4; i++) {
+		int su = i & 1 ? 1 : -1;
+		int sv = i & 2 ? 1 : -1;
+		corners[i] = glm::vec2(corner_ao(negative, u, v, su, sv),
+		                       corner_ao(positive, u, v, su, sv));
+	}
+
+	glm::vec3 middle = wall_size * glm::vec3(p);
+	for (int i = 0; i < 6; i++) {
+		glm::vec3 local = wall[i].pos - middle;
+		wall[i].ao = corners[(local[u] > 0.0f) | (local[v] > 0.0f) << 1];
+	}
+}
+
+// Each cell from from to to emits its negative walls, cells on the positive
+// border of the maze also emit the outer walls. The apron (of the chunk
+// starting at lo) is only read for the ao.
+static void mesh_cells(const uint8_t* apron,
+                       glm::ivec3 lo,
+                       glm::ivec3 from,
+                       glm::ivec3 to,
+                       glm::ivec3 size,
+                       float wall_size,
+                       std::vector<maze_vertex>& vertices) {
+	for (int z = from.z; z < to.z; z++) {
+		for (int y = from.y; y < to.y; y++) {
+			for (int x = from.x; x < to.x; x++) {
+				glm::ivec3 p(x, y, z);
+				uint8_t c = apron_cell(apron, lo, p);
+
+				auto wall = [&](uint32_t d) {
+					append_wall(vertices, d, wall_size, x, y, z, wall_material(p, d));
+					bake_wall_ao(apron, lo, p, d, wall_size, &vertices[vertices.size() - 6]);
+				};
+
+				if (!(c & XNEGATIVE)) {
+					wall(XNEGATIVE);
+				}
+
+				if (!(c & YNEGATIVE)) {
+					wall(YNEGATIVE);
 				}
-				
-				if (!(data[x][y][z] & YNEGATIVE)) {
-					append_wall(vertices, YNEGATIVE, wall_size, x, y, z);
+
+				if (!(c & ZNEGATIVE)) {
+					wall(ZNEGATIVE);
+				}
+
+				if (x == size.x - 1) {
+					wall(XPOSITIVE);
 				}
 
-				if (!(data[x][y][z] & ZNEGATIVE)) {
-					append_wall(vertices, ZNEGATIVE, wall_size, x, y, z);
+				if (y == size.y - 1) {
+					wall(YPOSITIVE);
+				}
+
+				if (z == size.z - 1) {
+					wall(ZPOSITIVE);
 				}
 			}
 		}
 	}
-	
-	// xpositive wall
-	for (int y = 0; y < MAZE_HEIGHT; y++) {
-		for (int z = 0; z < MAZE_LENGTH; z++) {
-			append_wall(vertices, XPOSITIVE, wall_size, MAZE_WIDTH - 1, y, z);
+}
+
+// Every wall, a block at a time so each block is a range of its own that can
+// be culled. block_first (if any) gets where each block starts, from where
+// the chunk does.
+static void mesh_chunk_full(const uint8_t* apron,
+                            glm::ivec3 lo,
+                            glm::ivec3 hi,
+                            glm::ivec3 size,
+                            float wall_size,
+                            std::vector<maze_vertex>& vertices,
+                            uint32_t* block_first) {
+	size_t start = vertices.size();
+	int block = 0;
+
+	for (int bz = 0; bz < MAZE_CHUNK_SIZE; bz += MAZE_BLOCK_SIZE) {
+		for (int by = 0; by < MAZE_CHUNK_SIZE; by += MAZE_BLOCK_SIZE) {
+			for (int bx = 0; bx < MAZE_CHUNK_SIZE; bx += MAZE_BLOCK_SIZE, block++) {
+				if (block_first)
+					block_first[block] = vertices.size() - start;
+
+				// blocks past the end of the maze are empty
+				glm::ivec3 from = glm::min(lo + glm::ivec3(bx, by, bz), hi);
+				glm::ivec3 to = glm::min(from + MAZE_BLOCK_SIZE, hi);
+				mesh_cells(apron, lo, from, to, size, wall_size, vertices);
 			}
+		}
 	}
-	
-	// ypositive wall
-	for (int x = 0; x < MAZE_WIDTH; x++) {
-		for (int z = 0; z < MAZE_LENGTH; z++) {
-			append_wall(vertices, YPOSITIVE, wall_size, x, MAZE_HEIGHT - 1, z);
+}
+
+// Only the walls lying on the six faces of the chunk, which is all that can
+// be seen of it from far away. Walls of a material on a face are merged into
+// rectangles.
+static void mesh_chunk_shell(const uint8_t* apron,
+                             glm::ivec3 lo,
+                             glm::ivec3 hi,
+                             float wall_size,
+                             std::vector<maze_vertex>& vertices) {
+	const uint32_t dirs[] = { XPOSITIVE, XNEGATIVE, YPOSITIVE, YNEGATIVE, ZPOSITIVE, ZNEGATIVE };
+	glm::ivec3 extent = hi - lo;
+
+	for (uint32_t d : dirs) {
+		glm::ivec3 dir = direction(d);
+		int n = dir.x ? 0 : dir.y ? 1 : 2;
+		int u = (n + 1) % 3;
+		int v = (n + 2) % 3;
+		int layer = dir[n] > 0 ? extent[n] - 1 : 0;
+
+		// the material of the wall plus one, 0 where there is none
+		uint8_t wall[MAZE_CHUNK_SIZE][MAZE_CHUNK_SIZE] = {};
+		for (int j = 0; j < extent[v]; j++) {
+			for (int i = 0; i < extent[u]; i++) {
+				glm::ivec3 l;
+				l[n] = layer;
+				l[u] = i;
+				l[v] = j;
+				if (!(apron_cell(apron, lo, lo + l) & d))
+					wall[j][i] = (uint8_t)(wall_material(lo + l, d) + 1);
+			}
+		}
+
+		// greedy: grow along u, then along v while the whole run is wall of
+		// the same material
+		for (int j = 0; j < extent[v]; j++) {
+			for (int i = 0; i < extent[u]; i++) {
+				uint8_t material = wall[j][i];
+				if (!material)
+					continue;
+
+				int w = 1;
+				while (i + w < extent[u] && wall[j][i + w] == material)
+					w++;
+
+				int h = 1;
+				for (; j + h < extent[v]; h++) {
+					bool full = true;
+					for (int k = 0; k < w && full; k++)
+						full = wall[j + h][i + k] == material;
+					if (!full)
+						break;
+				}
+
+				for (int y = 0; y < h; y++)
+					for (int x = 0; x < w; x++)
+						wall[j + y][i + x] = 0;
+
+				glm::ivec3 a, b;
+				a[n] = b[n] = lo[n] + layer;
+				a[u] = lo[u] + i;
+				a[v] = lo[v] + j;
+				b[u] = lo[u] + i + w - 1;
+				b[v] = lo[v] + j + h - 1;
+				append_rect(vertices, d, wall_size, a, b, material - 1);
 			}
+		}
 	}
-	
-	// zpositive wall
-	for (int x = 0; x < MAZE_WIDTH; x++) {
-		for (int y = 0; y < MAZE_HEIGHT; y++) {
-			append_wall(vertices, ZPOSITIVE, wall_size, x, y, MAZE_LENGTH - 1);
+}
+
+// The six faces of the chunk as a stand in for everything inside, each of the
+// material of its first cell.
+static void mesh_chunk_box(glm::ivec3 lo, glm::ivec3 hi, float wall_size, std::vector<maze_vertex>& vertices) {
+	glm::ivec3 top = hi - 1;
+	auto face = [&](uint32_t d, glm::ivec3 a, glm::ivec3 b) {
+		append_rect(vertices, d, wall_size, a, b, wall_material(a, d));
+	};
+
+	face(XNEGATIVE, lo, glm::ivec3(lo.x, top.y, top.z));
+	face(XPOSITIVE, glm::ivec3(top.x, lo.y, lo.z), top);
+	face(YNEGATIVE, lo, glm::ivec3(top.x, lo.y, top.z));
+	face(YPOSITIVE, glm::ivec3(lo.x, top.y, lo.z), top);
+	face(ZNEGATIVE, lo, glm::ivec3(top.x, top.y, lo.z));
+	face(ZPOSITIVE, glm::ivec3(lo.x, lo.y, top.z), top);
+}
+
+void mesh_chunk(const uint8_t* apron,
+                glm::ivec3 chunk,
+                glm::ivec3 size,
+                float wall_size,
+                int lod,
+                std::vector<maze_vertex>& vertices,
+                uint32_t* block_first) {
+	glm::ivec3 lo, hi;
+	chunk_cell_range(chunk, size, lo, hi);
+
+	switch (lod) {
+		case 0:
+			mesh_chunk_full(apron, lo, hi, size, wall_size, vertices, block_first);
+			break;
+		case 1:
+			mesh_chunk_shell(apron, lo, hi, wall_size, vertices);
+			break;
+		default:
+			mesh_chunk_box(lo, hi, wall_size, vertices);
+			break;
+	}
+}
+
+bool parse_maze_size(const char* s, glm::ivec3& size) {
+    int w, h, l;
+    if (std::sscanf(s, "%dx%dx%d", &w, &h, &l) == 3) {
+        size = glm::ivec3(w, h, l);
+    } else if (std::sscanf(s, "%d", &w) == 1) {
+        size = glm::ivec3(w);
+    } else {
+        return false;
+    }
+
+    return size.x > 0 && size.y > 0 && size.z > 0;
+}
+
+void mesh_chunk_lods(const uint8_t* apron,
+                     glm::ivec3 chunk,
+                     glm::ivec3 size,
+                     float wall_size,
+                     std::vector<maze_vertex>& vertices,
+                     maze_chunk& ranges) {
+	for (int lod = 0; lod < MAZE_LODS; lod++) {
+		ranges.first[lod] = vertices.size();
+		mesh_chunk(apron, chunk, size, wall_size, lod, vertices, ranges.block_first);
+		ranges.count[lod] = vertices.size() - ranges.first[lod];
+	}
+}
+
+int select_lod(float pixels, int current) {
+	// lod i is used while the chunk is at least limits[i] pixels big
+	const float limits[MAZE_LODS] = { MAZE_LOD1_PIXELS, MAZE_LOD2_PIXELS, 0.0f };
+
+	int ideal = 0;
+	while (ideal < MAZE_LODS - 1 && pixels < limits[ideal])
+		ideal++;
+
+	if (ideal > current && pixels < limits[current] / MAZE_LOD_HYSTERESIS)
+		return ideal;
+
+	if (ideal < current && pixels > limits[current - 1] * MAZE_LOD_HYSTERESIS)
+		return ideal;
+
+	return current;
+}
+
+#ifndef IT_NO_GL
+void maze_view::set_camera(glm::vec3 eye, float fovy, int viewport_height) {
+	this->eye = eye;
+	pixel_scale = viewport_height / (2.0f * std::tan(fovy / 2.0f));
+}
+#endif
+
+// All lods of a chunk are next to each other in the mesh, so a chunk (and
+// every lod of it) is one contiguous range. The rows of chunks are split in a
+// block per thread, the first one meshes straight into vertices and the
+// others into their own, appended in order after so the mesh is the same on
+// any number of threads.
+void maze::gen_vertices(float wall_size) {
+	TRACE_ZONE("maze gen_vertices");
+
+	this->wall_size = wall_size;
+	vertices.clear();
+	chunk_table.assign((size_t)chunks.x * chunks.y * chunks.z, maze_chunk{});
+
+	int rows = chunks.y * chunks.z;
+	int blocks = std::min(rows, job_workers() + 1);
+	int block_rows = (rows + blocks - 1) / blocks;
+	blocks = (rows + block_rows - 1) / block_rows;
+	std::vector<std::vector<maze_vertex>> block_vertices(blocks - 1);
+
+	job_parallel_for(rows, block_rows, [&](int begin, int end) {
+		TRACE_ZONE("maze mesh block");
+		int block = begin / block_rows;
+		std::vector<maze_vertex>& out = block ? block_vertices[block - 1] : vertices;
+		std::vector<uint8_t> apron(MAZE_APRON_CELLS);
+
+		for (int row = begin; row < end; row++) {
+			int cy = row % chunks.y;
+			int cz = row / chunks.y;
+
+			for (int cx = 0; cx < chunks.x; cx++) {
+				gather_apron(glm::ivec3(cx, cy, cz), apron.data());
+				mesh_chunk_lods(apron.data(),
+				                glm::ivec3(cx, cy, cz),
+				                size,
+				                wall_size,
+				                out,
+				                chunk_table[(size_t)row * chunks.x + cx]);
 			}
+		}
+	});
+
+	size_t total = vertices.size();
+	for (const std::vector<maze_vertex>& v : block_vertices)
+		total += v.size();
+	vertices.reserve(total);
+
+	// their ranges are relative to the start of the block
+	for (int block = 1; block < blocks; block++) {
+		uint32_t base = (uint32_t)vertices.size();
+		size_t first = (size_t)block * block_rows * chunks.x;
+		size_t last = std::min((size_t)(block + 1) * block_rows, (size_t)rows) * chunks.x;
+		for (size_t i = first; i < last; i++) {
+			for (int lod = 0; lod < MAZE_LODS; lod++)
+				chunk_table[i].first[lod] += base;
+		}
+
+		std::vector<maze_vertex>& v = block_vertices[block - 1];
+		vertices.insert(vertices.end(), v.begin(), v.end());
+		std::vector<maze_vertex>().swap(v);
 	}
+
+	mesh = vertices.data();
+	mesh_vertices = vertices.size();
+	chunk_ranges = chunk_table.data();
+	account_mesh();
 }
 
-static void append_wall(std::vector<glm::vec3> &vertices, int d, float wall_size, int x, int y, int z) {
-	const glm::vec3 quad_vertices[] = {
-		glm::vec3( 1.0f,  1.0f,  1.0f),
-		glm::vec3(-1.0f,  1.0f,  1.0f),
-		glm::vec3( 1.0f, -1.0f,  1.0f),
+// The six corners of the quad facing each direction (indexed by the bit of
+// the direction), rotated once instead of for every wall.
+struct wall_quads {
+	glm::vec3 corners[6][6];
+
+	wall_quads() {
+		const glm::vec3 quad_vertices[] = {
+			glm::vec3( 1.0f,  1.0f,  1.0f),
+			glm::vec3(-1.0f,  1.0f,  1.0f),
+			glm::vec3( 1.0f, -1.0f,  1.0f),
+
+			glm::vec3(-1.0f, -1.0f,  1.0f),
+			glm::vec3( 1.0f, -1.0f,  1.0f),
+			glm::vec3(-1.0f,  1.0f,  1.0f),
+		};
+
+		for (int bit = 0; bit < 6; bit++) {
+			int d = 1 << bit;
+			float angle = glm::radians(quad_angle_to_rotate(d));
+			glm::vec3 dir = quad_vector_to_rotate(d);
+			for (int i = 0; i < 6; i++) {
+				corners[bit][i] = glm::rotate(quad_vertices[i], angle, dir);
+			}
+		}
+	}
+};
+
+static void append_wall(std::vector<maze_vertex> &vertices, int d, float wall_size, int x, int y, int z, uint32_t material) {
+	static const wall_quads quads;
+	const glm::vec3* corners = quads.corners[std::countr_zero((uint32_t)d)];
+	glm::vec3 normal = glm::abs(direction(d));
 
-		glm::vec3(-1.0f, -1.0f,  1.0f),
-		glm::vec3( 1.0f, -1.0f,  1.0f),
-		glm::vec3(-1.0f,  1.0f,  1.0f),
-	};
-	
 	for (int i = 0; i < 6; i++) {
-		float angle = glm::radians(quad_angle_to_rotate(d));
-		glm::vec3 dir = quad_vector_to_rotate(d);
-		glm::vec3 vertex = glm::rotate(quad_vertices[i], angle, dir);
-		vertices.push_back((wall_size / 2) * vertex + wall_size * glm::vec3(x, y, z));
-		vertices.push_back((glm::vec3)glm::abs(direction(d)));
+		vertices.push_back({
+			(wall_size / 2) * corners[i] + wall_size * glm::vec3(x, y, z),
+			normal,
+			glm::vec2(1.0f),
+			material,
+		});
 	}
 }
 
-void maze::print() const {
+void maze::print(std::FILE* out) const {
 
     // nine by nine, very ugly probably.
-    for (int y = 0; y < MAZE_HEIGHT; y++) {
-        std::printf("\n\nY: %d\n", y);
-        for (int z = 0; z < MAZE_HEIGHT; z++) {
+    for (int y = 0; y < size.y; y++) {
+        std::fprintf(out, "\n\nY: %d\n", y);
+        for (int z = 0; z < size.z; z++) {
 
             // top line
-            for (int x = 0; x < MAZE_WIDTH; x++) {
-                std::putchar('+');
+            for (int x = 0; x < size.x; x++) {
+                std::putc('+', out);
 
-                if (data[x][y][z] & ZNEGATIVE)
-                    std::putchar('.');
+                if (cell(glm::ivec3(x, y, z)) & ZNEGATIVE)
+                    std::putc('.', out);
                 else
-                    std::putchar('-');
+                    std::putc('-', out);
             }
 
-            std::putchar('+');
-            std::putchar('\n');
+            std::putc('+', out);
+            std::putc('\n', out);
 
-            if (data[0][y][z] & XNEGATIVE)
-                std::putchar('.');
+            if (cell(glm::ivec3(0, y, z)) & XNEGATIVE)
+                std::putc('.', out);
             else
-                std::putchar('|');
+                std::putc('|', out);
 
             // bottom line
-            for (int x = 0; x < MAZE_WIDTH; x++) {
-                if ((data[x][y][z] & YPOSITIVE) && (data[x][y][z] & YNEGATIVE))
-                    std::putchar('B');
-                else if (data[x][y][z] & YPOSITIVE)
-                    std::putchar('U');
-                else if (data[x][y][z] & YNEGATIVE)
-                    std::putchar('D');
+            for (int x = 0; x < size.x; x++) {
+                uint8_t c = cell(glm::ivec3(x, y, z));
+                if ((c & YPOSITIVE) && (c & YNEGATIVE))
+                    std::putc('B', out);
+                else if (c & YPOSITIVE)
+                    std::putc('U', out);
+                else if (c & YNEGATIVE)
+                    std::putc('D', out);
                 else 
-                    std::putchar('.');
+                    std::putc('.', out);
 
-                if (data[x][y][z] & XPOSITIVE)
-                    std::putchar('.');
+                if (c & XPOSITIVE)
+                    std::putc('.', out);
                 else
-                    std::putchar('|');
+                    std::putc('|', out);
             }
 
-            std::putchar('\n');
+            std::putc('\n', out);
         }
 
-        for (int x = 0; x < MAZE_WIDTH; x++) {
-            std::putchar('+');
+        for (int x = 0; x < size.x; x++) {
+            std::putc('+', out);
             
-            if (data[x][y][MAZE_LENGTH - 1] & ZPOSITIVE)
-                std::putchar('.');
+            if (cell(glm::ivec3(x, y, size.z - 1)) & ZPOSITIVE)
+                std::putc('.', out);
             else
-                std::putchar('-');
+                std::putc('-', out);
         }
 
-        std::putchar('+');
+        std::putc('+', out);
     }
-    std::printf("\n");
+    std::fprintf(out, "\n");
 
     //for (int x = 0; x < MAZE_WIDTH; x++) {
     //    for (int y = 0; y < MAZE_HEIGHT; y++) {
@@ -265,7 +716,222 @@ void maze::print() const {
     //}
 }
 
+// Union-find over the cells: every passage joins two sets, a passage between
+// cells already joined closes a loop. A tree has exactly cells - 1 passages.
+bool maze::validate() const {
+	const uint32_t dirs[] = { XPOSITIVE, XNEGATIVE, YPOSITIVE, YNEGATIVE, ZPOSITIVE, ZNEGATIVE };
+	const uint32_t positive = XPOSITIVE | YPOSITIVE | ZPOSITIVE;
+	const uint8_t all = XPOSITIVE | XNEGATIVE | YPOSITIVE | YNEGATIVE | ZPOSITIVE | ZNEGATIVE;
+
+	size_t cell_count = (size_t)size.x * size.y * size.z;
+	std::vector<uint32_t> parent(cell_count);
+	for (size_t i = 0; i < cell_count; i++)
+		parent[i] = (uint32_t)i;
+
+	auto find = [&parent](uint32_t i) {
+		while (parent[i] != i) {
+			parent[i] = parent[parent[i]];
+			i = parent[i];
+		}
+		return i;
+	};
+	auto pack = [this](glm::ivec3 p) {
+		return (uint32_t)((p.z * size.y + p.y) * size.x + p.x);
+	};
+
+	size_t passages = 0;
+	for (int z = 0; z < size.z; z++) {
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) {
+				glm::ivec3 p(x, y, z);
+				uint8_t c = cell(p);
+
+				if (c & ~all) {
+					std::fprintf(stderr, "ERROR: Maze: cell %d %d %d has unknown bits %02x\n", x, y, z, c);
+					return false;
+				}
+
+				for (uint32_t d : dirs) {
+					if (!(c & d))
+						continue;
+
+					glm::ivec3 next = p + direction(d);
+					if (!in_bounds(next) || !(cell(next) & opposite(d))) {
+						std::fprintf(stderr, "ERROR: Maze: passage from %d %d %d has no other side\n", x, y, z);
+						return false;
+					}
+
+					// each passage is joined once, from the cell on its negative side
+					if (!(d & positive))
+						continue;
+
+					uint32_t a = find(pack(p));
+					uint32_t b = find(pack(next));
+					if (a == b) {
+						std::fprintf(stderr, "ERROR: Maze: passage from %d %d %d closes a loop\n", x, y, z);
+						return false;
+					}
+
+					parent[a] = b;
+					passages++;
+				}
+			}
+		}
+	}
+
+	if (passages != cell_count - 1) {
+		std::fprintf(stderr, "ERROR: Maze: %zu passages join %zu cells, not a single tree\n", passages, cell_count);
+		return false;
+	}
+
+	return true;
+}
+
+bool maze::save(const char* path, bool with_mesh) const {
+    TRACE_ZONE("maze save");
+
+    maze_file_header header = {};
+    header.size[0] = size.x;
+    header.size[1] = size.y;
+    header.size[2] = size.z;
+    header.seed = seed;
+    header.algorithm = MAZE_ALGORITHM_BACKTRACKER;
+    header.chunk_size = MAZE_CHUNK_SIZE;
+    // not meshed yet, it is meshed at the default size when loaded
+    header.wall_size = wall_size > 0.0f ? wall_size : MAZE_WALL_SIZE;
+
+    size_t chunk_count = (size_t)chunks.x * chunks.y * chunks.z;
+    with_mesh = with_mesh && mesh;
+
+    return write_maze_file(
+            path,
+            header,
+            { cells, chunk_count * MAZE_CHUNK_CELLS },
+            { chunk_ranges, with_mesh ? chunk_count * sizeof(maze_chunk) : 0 },
+            { mesh, with_mesh ? mesh_vertices * sizeof(maze_vertex) : 0 });
+}
+
+// The lods of every chunk are back to back within the mesh and its blocks
+// one after another within lod 0, what init_gl and the streamer draw and copy
+// without looking.
+static bool valid_chunk_table(const maze_chunk* table, size_t chunk_count, uint64_t vertex_count) {
+    for (size_t i = 0; i < chunk_count; i++) {
+        const maze_chunk& c = table[i];
+
+        uint64_t end = c.first[0];
+        for (int lod = 0; lod < MAZE_LODS; lod++) {
+            if (c.first[lod] < end)
+                return false;
+            end = (uint64_t) c.first[lod] + c.count[lod];
+        }
+        if (end > vertex_count)
+            return false;
+
+        uint32_t block = 0;
+        for (uint32_t first : c.block_first) {
+            if (first < block || first > c.count[0])
+                return false;
+            block = first;
+        }
+    }
+    return true;
+}
+
+// Nothing is parsed or copied, the cells (and the mesh when there is one) are
+// used in place from the mapping.
+bool maze::load(const char* path) {
+    TRACE_ZONE("maze load");
+
+    if (!file.map(path))
+        return false;
+
+    const maze_file_header* header = file.header();
+    if (!header)
+        return false;
+
+    glm::ivec3 file_size(header->size[0], header->size[1], header->size[2]);
+    if (file_size.x <= 0 || file_size.y <= 0 || file_size.z <= 0) {
+        std::fprintf(stderr, "ERROR: Maze: %s has a bad size\n", path);
+        return false;
+    }
+
+    glm::ivec3 file_chunks = (file_size + (MAZE_CHUNK_SIZE - 1)) / MAZE_CHUNK_SIZE;
+    size_t chunk_count = (size_t)file_chunks.x * file_chunks.y * file_chunks.z;
+
+    if (header->chunk_size != MAZE_CHUNK_SIZE ||
+        header->cells_bytes != chunk_count * MAZE_CHUNK_CELLS) {
+        std::fprintf(stderr, "ERROR: Maze: %s has an incompatible cell layout\n", path);
+        return false;
+    }
+
+    // it-gen used to write 0, those files have no mesh it could disagree with
+    bool has_mesh = header->flags & MAZE_FILE_HAS_MESH;
+    if (!(header->wall_size > 0.0f) && has_mesh) {
+        std::fprintf(stderr, "ERROR: Maze: %s has a mesh but no wall size\n", path);
+        return false;
+    }
+
+    size = file_size;
+    chunks = file_chunks;
+    seed = header->seed;
+    wall_size = header->wall_size > 0.0f ? header->wall_size : MAZE_WALL_SIZE;
+    cells = file.at(header->cells_offset);
+    cell_storage.clear();
+    cell_storage.shrink_to_fit();
+    cells_memory.set(0);
+
+    std::vector<maze_vertex>().swap(vertices);
+    std::vector<maze_chunk>().swap(chunk_table);
+    account_mesh();
+    mesh = nullptr;
+    mesh_vertices = 0;
+    chunk_ranges = nullptr;
+
+    if (has_mesh &&
+        header->chunks_bytes == chunk_count * sizeof(maze_chunk)) {
+        const maze_chunk* table = (const maze_chunk*) file.at(header->chunks_offset);
+        uint64_t vertex_count = header->mesh_bytes / sizeof(maze_vertex);
+        if (header->mesh_bytes % sizeof(maze_vertex) || !valid_chunk_table(table, chunk_count, vertex_count)) {
+            std::fprintf(stderr, "ERROR: Maze: %s has a corrupt mesh\n", path);
+            return false;
+        }
+
+        file.will_need(header->mesh_offset, header->mesh_bytes);
+        mesh = (const maze_vertex*) file.at(header->mesh_offset);
+        mesh_vertices = vertex_count;
+        chunk_ranges = table;
+    }
+
+    return true;
+}
+
+#ifndef IT_NO_GL
+bool maze::start_streaming(int radius, size_t budget_bytes) {
+    if (!file.is_mapped()) {
+        std::fprintf(stderr, "ERROR: Maze: only loaded mazes can be streamed\n");
+        return false;
+    }
+
+    streamer = std::make_unique<maze_streamer>(*this, radius, budget_bytes);
+    return true;
+}
+
+bool maze::stream(glm::vec3 cam_pos) {
+    return streamer && streamer->update(cam_pos);
+}
+
+bool maze::stream_pending() const {
+    return streamer && streamer->pending();
+}
+
 void maze::init_gl() {
+    TRACE_ZONE("maze init_gl");
+
+    if (streamer) {
+        streamer->init_gl();
+        return;
+    }
+
     // create a vertex buffer object and initialize it
     glGenBuffers(1, &vbo);
 
@@ -278,20 +944,35 @@ void maze::init_gl() {
     // bind vbo to current array_buffer
     glBindBuffer(GL_ARRAY_BUFFER, vbo);
 
-    // set the data of the current array_buffer
+    // set the data of the current array_buffer, for a loaded maze this reads
+    // straight from the mapped pages of the file.
     glBufferData(
             GL_ARRAY_BUFFER,
-            vertices.size() * sizeof(glm::vec3),
-            vertices.data(),
-            GL_DYNAMIC_DRAW);
+            mesh_vertices * sizeof(maze_vertex),
+            mesh,
+            GL_STATIC_DRAW);
+
+    // the copy is the GL's now
+    if (mesh && !vertices.empty()) {
+        std::vector<maze_vertex>().swap(vertices);
+    } else if (mesh) {
+        const maze_file_header* header = file.header();
+        file.release(header->mesh_offset, header->mesh_bytes);
+    }
+    mesh = nullptr;
+    account_mesh();
 
     // in shader: (location = vertex_attrib_index)
     const GLuint maze_vertex_attrib_index = 0;
     const GLuint maze_color_attrib_index = 1;
+    const GLuint maze_ao_attrib_index = 2;
+    const GLuint maze_material_attrib_index = 4;
 
     // enable attrib
     glEnableVertexAttribArray(maze_vertex_attrib_index);
     glEnableVertexAttribArray(maze_color_attrib_index);
+    glEnableVertexAttribArray(maze_ao_attrib_index);
+    glEnableVertexAttribArray(maze_material_attrib_index);
 
     // show opengl how to interpret the attrib
     glVertexAttribPointer(
@@ -299,19 +980,287 @@ void maze::init_gl() {
             3,
             GL_FLOAT,
             GL_FALSE,
-            6 * sizeof(float),
-            (void*)0);
+            sizeof(maze_vertex),
+            (void*)offsetof(maze_vertex, pos));
 
     glVertexAttribPointer(
             maze_color_attrib_index,
             3,
             GL_FLOAT,
             GL_FALSE,
-            6 * sizeof(float),
-            (void*)(3 * sizeof(float)));
+            sizeof(maze_vertex),
+            (void*)offsetof(maze_vertex, color));
+
+    glVertexAttribPointer(
+            maze_ao_attrib_index,
+            2,
+            GL_FLOAT,
+            GL_FALSE,
+            sizeof(maze_vertex),
+            (void*)offsetof(maze_vertex, ao));
+
+    glVertexAttribIPointer(
+            maze_material_attrib_index,
+            1,
+            GL_UNSIGNED_INT,
+            sizeof(maze_vertex),
+            (void*)offsetof(maze_vertex, material));
+
+    // the view index, one per instance
+    const GLuint maze_view_attrib_index = 3;
+    const GLuint view_indices[MAZE_MAX_VIEWS] = { 0, 1, 2, 3 };
+    static_assert(MAZE_MAX_VIEWS == 4, "view_indices doesn't cover every view");
+
+    glGenBuffers(1, &view_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, view_vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(view_indices), view_indices, GL_STATIC_DRAW);
+    gpu_memory.set(mesh_vertices * sizeof(maze_vertex) + sizeof(view_indices));
+
+    glEnableVertexAttribArray(maze_view_attrib_index);
+    glVertexAttribIPointer(maze_view_attrib_index, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+    glVertexAttribDivisor(maze_view_attrib_index, 1);
+}
+
+int maze::chunk_lod(maze_view& view, size_t index, glm::ivec3 chunk) const {
+        glm::ivec3 lo, hi;
+        chunk_cell_range(chunk, size, lo, hi);
+
+        // bounding sphere of the chunk, cells are centered on wall_size steps
+        glm::vec3 min = (glm::vec3(lo) - 0.5f) * wall_size;
+        glm::vec3 max = (glm::vec3(hi) - 0.5f) * wall_size;
+        glm::vec3 center = 0.5f * (min + max);
+        float radius = 0.5f * glm::length(max - min);
+        float distance = glm::length(center - view.eye);
+
+        if (view.cull_distance > 0.0f &&
+            glm::length(glm::clamp(view.eye, min, max) - view.eye) > view.cull_distance) {
+            bool lit = false;
+            for (const glm::vec4& light : view.far_lights) {
+                glm::vec3 pos = glm::vec3(light);
+                lit = lit || glm::length(glm::clamp(pos, min, max) - pos) <= light.w;
+            }
+            if (!lit)
+                return -1;
+        }
+
+        if (view.cull_occluded && !view.occlusion.visible(min, max, MAZE_OCCLUSION_BIAS * wall_size))
+            return -1;
+
+        int lod = 0;
+        if (distance > radius)
+            lod = select_lod(view.pixel_scale * 2.0f * radius / distance, view.lods[index]);
+
+        view.lods[index] = lod;
+        return lod;
+}
+
+// Walls of the cells around the eye, on each plane a run of walls along a
+// row is one quad. Only what is behind the walls this close is culled, but
+// inside a maze that is most of it.
+void maze::build_occlusion(maze_view& view) const {
+        TRACE_ZONE("maze build_occlusion");
+
+        glm::ivec3 eye = glm::ivec3(glm::floor(view.eye / wall_size + 0.5f));
+        glm::ivec3 lo = glm::clamp(eye - MAZE_OCCLUDER_RADIUS, glm::ivec3(0), size - 1);
+        glm::ivec3 hi = glm::clamp(eye + MAZE_OCCLUDER_RADIUS, glm::ivec3(0), size - 1);
+
+        view.occluders.clear();
+        for (int n = 0; n < 3; n++) {
+            // walls facing along n, on the plane spanned by m and o
+            int m = n ? 0 : 1;
+            int o = 3 - n - m;
+            uint32_t d = axis_dirs[n][0];
+            int width = hi[m] - lo[m] + 1;
+            int height = hi[o] - lo[o] + 1;
+
+            // the wall at plane a is the negative one of cell a, past the
+            // last cell it is the outer wall
+            for (int a = lo[n]; a <= hi[n] + 1; a++) {
+                bool wall[MAZE_OCCLUDER_CELLS][MAZE_OCCLUDER_CELLS];
+                for (int j = 0; j < height; j++) {
+                    for (int i = 0; i < width; i++) {
+                        glm::ivec3 p;
+                        p[n] = a;
+                        p[m] = lo[m] + i;
+                        p[o] = lo[o] + j;
+                        wall[j][i] = a == size[n] || !(cell(p) & d);
+                    }
+                }
+
+                // Greedy rectangles: a run along m, grown along o while the
+                // next row has the same run. Fewer and larger occluders, and
+                // fewer seams between them, which cover no pixel.
+                for (int j = 0; j < height; j++) {
+                    for (int i = 0; i < width; i++) {
+                        if (!wall[j][i])
+                            continue;
+
+                        int i1 = i;
+                        while (i1 < width && wall[j][i1])
+                            i1++;
+
+                        int j1 = j + 1;
+                        while (j1 < height && std::all_of(&wall[j1][i], &wall[j1][i1], [](bool w) { return w; }))
+                            j1++;
+
+                        for (int jj = j; jj < j1; jj++)
+                            std::fill(&wall[jj][i], &wall[jj][i1], false);
+
+                        // from the corner of the first cell to that of the
+                        // last, on the plane
+                        glm::vec3 c0, c1, c2, c3;
+                        c0[n] = c1[n] = c2[n] = c3[n] = (a - 0.5f) * wall_size;
+                        c0[m] = c3[m] = (lo[m] + i - 0.5f) * wall_size;
+                        c1[m] = c2[m] = (lo[m] + i1 - 0.5f) * wall_size;
+                        c0[o] = c1[o] = (lo[o] + j - 0.5f) * wall_size;
+                        c2[o] = c3[o] = (lo[o] + j1 - 0.5f) * wall_size;
+                        view.occluders.push_back({ { c0, c1, c2, c3 } });
+                        i = i1 - 1;
+                    }
+                }
+            }
+        }
+
+        view.occlusion.rasterize(view.view_proj, view.occluders);
+}
+
+int maze::chunk_runs(const maze_view& view, const maze_chunk& ranges, glm::ivec3 chunk, int lod,
+                     uint32_t* firsts, uint32_t* counts) const {
+        if (lod || !view.cull_occluded) {
+            firsts[0] = ranges.first[lod];
+            counts[0] = ranges.count[lod];
+            return ranges.count[lod] ? 1 : 0;
+        }
+
+        glm::ivec3 lo, hi;
+        chunk_cell_range(chunk, size, lo, hi);
+        float bias = MAZE_OCCLUSION_BIAS * wall_size;
+
+        int runs = 0;
+        int block = 0;
+        for (int bz = 0; bz < MAZE_CHUNK_SIZE; bz += MAZE_BLOCK_SIZE) {
+            for (int by = 0; by < MAZE_CHUNK_SIZE; by += MAZE_BLOCK_SIZE) {
+                for (int bx = 0; bx < MAZE_CHUNK_SIZE; bx += MAZE_BLOCK_SIZE, block++) {
+                    uint32_t begin = ranges.block_first[block];
+                    uint32_t end = block + 1 < MAZE_CHUNK_BLOCKS ? ranges.block_first[block + 1] : ranges.count[0];
+                    if (begin == end)
+                        continue;
+
+                    // the walls of a block are on the faces of its cells
+                    glm::ivec3 from = lo + glm::ivec3(bx, by, bz);
+                    glm::ivec3 to = glm::min(from + MAZE_BLOCK_SIZE, hi);
+                    glm::vec3 min = (glm::vec3(from) - 0.5f) * wall_size;
+                    glm::vec3 max = (glm::vec3(to) - 0.5f) * wall_size;
+                    if (!view.occlusion.visible(min, max, bias))
+                        continue;
+
+                    uint32_t first = ranges.first[0] + begin;
+                    if (runs && firsts[runs - 1] + counts[runs - 1] == first) {
+                        counts[runs - 1] += end - begin;
+                    } else {
+                        firsts[runs] = first;
+                        counts[runs] = end - begin;
+                        runs++;
+                    }
+                }
+            }
+        }
+        return runs;
 }
 
-void maze::render() const {
+void maze::render(maze_view& view) const {
+        size_t chunk_count = (size_t)chunks.x * chunks.y * chunks.z;
+        view.lods.resize(chunk_count, 0);
+        view.triangles = 0;
+
+        if (view.cull_occluded)
+            build_occlusion(view);
+
+        if (streamer) {
+            streamer->render(view);
+            return;
+        }
+
+        // one multi draw for every chunk, each at its own lod
+        view.firsts.clear();
+        view.counts.clear();
+        uint32_t firsts[MAZE_CHUNK_BLOCKS];
+        uint32_t counts[MAZE_CHUNK_BLOCKS];
+
+        size_t i = 0;
+        for (int cz = 0; cz < chunks.z; cz++) {
+            for (int cy = 0; cy < chunks.y; cy++) {
+                for (int cx = 0; cx < chunks.x; cx++, i++) {
+                    glm::ivec3 chunk(cx, cy, cz);
+                    int lod = chunk_lod(view, i, chunk);
+                    if (lod < 0)
+                        continue;
+
+                    int runs = chunk_runs(view, chunk_ranges[i], chunk, lod, firsts, counts);
+                    for (int r = 0; r < runs; r++) {
+                        view.firsts.push_back(firsts[r]);
+                        view.counts.push_back(counts[r]);
+                        view.triangles += counts[r] / 3;
+                    }
+                }
+            }
+        }
+
+        glBindVertexArray(vao);
+        glMultiDrawArrays(GL_TRIANGLES, view.firsts.data(), view.counts.data(), view.firsts.size());
+}
+
+uint64_t maze_view_set::triangles() const {
+        uint64_t sum = 0;
+        for (const maze_view& view : views)
+            sum += view.triangles;
+        return sum;
+}
+
+void maze::render_views(maze_view_set& set) const {
+        size_t chunk_count = (size_t)chunks.x * chunks.y * chunks.z;
+        int view_count = (int) glm::min(set.views.size(), (size_t) MAZE_MAX_VIEWS);
+
+        set.commands.clear();
+        uint32_t firsts[MAZE_CHUNK_BLOCKS];
+        uint32_t counts[MAZE_CHUNK_BLOCKS];
+        for (int v = 0; v < view_count; v++) {
+            maze_view& view = set.views[v];
+            view.lods.resize(chunk_count, 0);
+            view.triangles = 0;
+            if (view.cull_occluded)
+                build_occlusion(view);
+
+            size_t i = 0;
+            for (int cz = 0; cz < chunks.z; cz++) {
+                for (int cy = 0; cy < chunks.y; cy++) {
+                    for (int cx = 0; cx < chunks.x; cx++, i++) {
+                        glm::ivec3 chunk(cx, cy, cz);
+                        int lod = chunk_lod(view, i, chunk);
+                        if (lod < 0)
+                            continue;
+
+                        int runs = chunk_runs(view, chunk_ranges[i], chunk, lod, firsts, counts);
+                        for (int r = 0; r < runs; r++) {
+                            set.commands.push_back({ counts[r], 1, firsts[r], (GLuint) v });
+                            view.triangles += counts[r] / 3;
+                        }
+                    }
+                }
+            }
+        }
+
+        // all the views' draws go up in one buffer
+        if (!set.indirect_buffer)
+            glGenBuffers(1, &set.indirect_buffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, set.indirect_buffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER,
+                     set.commands.size() * sizeof(draw_arrays_command),
+                     set.commands.data(),
+                     GL_STREAM_DRAW);
+
         glBindVertexArray(vao);
-        glDrawArrays(GL_TRIANGLES, 0, vertices.size());
+        glMultiDrawArraysIndirect(GL_TRIANGLES, nullptr, set.commands.size(), 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
 }
+#endif
\ No newline at end of file
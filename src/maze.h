@@ -1,29 +1,328 @@
 #ifndef IT_MAZE_H
 #define IT_MAZE_H
 
+// IT_NO_GL leaves out everything that draws, for the tools that only
+// generate mazes and shouldn't link GL.
+#ifndef IT_NO_GL
 #include <GL/glew.h>
+#endif
+
 #include <glm/glm.hpp>
 
+#include <cstdint>
+#include <cstdio>
+#include <memory>
 #include <vector>
 
+#include "maze_file.h"
+#include "memory.h"
+#include "occlusion.h"
+
 #define MAZE_WIDTH  10
 #define MAZE_HEIGHT 10
 #define MAZE_LENGTH 10
 
+// The side of a cell in world units that it meshes mazes at, also what a maze
+// file saved before meshing (it-gen's) is meshed at when loaded.
+#define MAZE_WALL_SIZE 10.0f
+
+// Cells are stored in bricks of MAZE_CHUNK_SIZE^3, so a chunk is one
+// contiguous run of bytes (in memory and in the maze file).
+#define MAZE_CHUNK_SHIFT 4
+#define MAZE_CHUNK_SIZE  (1 << MAZE_CHUNK_SHIFT)
+#define MAZE_CHUNK_CELLS (MAZE_CHUNK_SIZE * MAZE_CHUNK_SIZE * MAZE_CHUNK_SIZE)
+
+// A chunk with the cells around it, what meshing one chunk reads. Cells of
+// the apron outside the maze are MAZE_APRON_OUTSIDE.
+#define MAZE_APRON_SIZE    (MAZE_CHUNK_SIZE + 2)
+#define MAZE_APRON_CELLS   (MAZE_APRON_SIZE * MAZE_APRON_SIZE * MAZE_APRON_SIZE)
+#define MAZE_APRON_OUTSIDE 0x80
+
+// How much darker each wall touching a corner makes it.
+#define MAZE_AO_STEP 0.1f
+
+// Walls are of one of MAZE_MATERIALS materials, the layers of the renderer's
+// material texture array. All walls of a region of 2^MAZE_MATERIAL_SHIFT
+// cells each way are of the same one.
+#define MAZE_MATERIALS      4
+#define MAZE_MATERIAL_SHIFT 2
+
+// A set bit means there is a passage in that direction.
+#define XPOSITIVE 0x01
+#define XNEGATIVE 0x02
+#define YPOSITIVE 0x04
+#define YNEGATIVE 0x08
+#define ZPOSITIVE 0x10
+#define ZNEGATIVE 0x20
+
+enum maze_algorithm { MAZE_ALGORITHM_BACKTRACKER };
+
+uint32_t opposite(uint32_t d);
+glm::ivec3 direction(uint32_t d);
+
+struct maze_vertex {
+    glm::vec3 pos;
+    glm::vec3 color;
+    // ambient occlusion of the wall seen from its negative and its positive
+    // side, 1 is unoccluded.
+    glm::vec2 ao;
+    // layer of the material texture array, the texture coordinates come
+    // from pos.
+    uint32_t material;
+};
+
+// Level of detail of a chunk mesh:
+// 0 - every wall.
+// 1 - only the walls on the chunk boundary, coplanar ones merged.
+// 2 - the bounding box of the chunk.
+#define MAZE_LODS 3
+
+// Projected chunk diameter (in pixels) under which the next coarser level is
+// used, and how far past a limit a chunk has to go before it switches back.
+#define MAZE_LOD1_PIXELS 400.0f
+#define MAZE_LOD2_PIXELS 120.0f
+#define MAZE_LOD_HYSTERESIS 1.25f
+
+// Walls of the cells up to this many cells from the eye are the occluders
+// chunks are tested against, merged into rectangles on each plane.
+#define MAZE_OCCLUDER_RADIUS 3
+#define MAZE_OCCLUDER_CELLS  (2 * MAZE_OCCLUDER_RADIUS + 1)
+// how much nearer (in walls) an occluder has to be than a chunk (or block)
+// to hide it, so the walls on its face don't hide it itself.
+#define MAZE_OCCLUSION_BIAS 0.05f
+
+// Lod 0 of a chunk is meshed a block of MAZE_BLOCK_SIZE^3 cells at a time,
+// x fastest, so a block is a range of it that is culled on its own.
+#define MAZE_BLOCK_SHIFT  2
+#define MAZE_BLOCK_SIZE   (1 << MAZE_BLOCK_SHIFT)
+#define MAZE_CHUNK_BLOCKS ((MAZE_CHUNK_SIZE / MAZE_BLOCK_SIZE) * (MAZE_CHUNK_SIZE / MAZE_BLOCK_SIZE) * (MAZE_CHUNK_SIZE / MAZE_BLOCK_SIZE))
+
+/**
+ * @brief Ranges of the mesh that belong to one chunk, one per lod, and where
+ * each block of lod 0 starts from first[0].
+ */
+struct maze_chunk {
+    uint32_t first[MAZE_LODS];
+    uint32_t count[MAZE_LODS];
+    uint32_t block_first[MAZE_CHUNK_BLOCKS];
+};
+
+/**
+ * @brief Appends the walls of one chunk at the given lod to vertices. apron
+ * has the MAZE_APRON_CELLS cells of the chunk at chunk (in chunk units) and
+ * its neighbours, see maze::gather_apron. For lod 0 block_first (if any)
+ * gets the block starts, as in maze_chunk.
+ */
+void mesh_chunk(const uint8_t* apron,
+                glm::ivec3 chunk,
+                glm::ivec3 size,
+                float wall_size,
+                int lod,
+                std::vector<maze_vertex>& vertices,
+                uint32_t* block_first = nullptr);
+
+/**
+ * @brief Builds every lod of a chunk into vertices, ranges are relative to
+ * the start of vertices.
+ */
+void mesh_chunk_lods(const uint8_t* apron,
+                     glm::ivec3 chunk,
+                     glm::ivec3 size,
+                     float wall_size,
+                     std::vector<maze_vertex>& vertices,
+                     maze_chunk& ranges);
+
+// A maze size on the command line, one edge length (32) or all three
+// (32x16x8), each above 0. What it, it-gen and it-server all take.
+bool parse_maze_size(const char* s, glm::ivec3& size);
+
+/**
+ * @brief Picks the lod for a chunk that projects to pixels, starting from
+ * the lod it had last frame so it doesn't pop back and forth at a limit.
+ */
+int select_lod(float pixels, int current);
+
+#ifndef IT_NO_GL
+/**
+ * @brief A camera the maze is drawn from. Keeps the lod of every chunk from
+ * the previous frame, so each camera needs its own.
+ */
+struct maze_view {
+    glm::vec3 eye = glm::vec3(0.0f);
+    // viewport height / (2 tan(fovy / 2)), turns size / distance into pixels.
+    float pixel_scale = 1.0f;
+
+    // chunks with nothing closer than this aren't drawn, unless one of
+    // far_lights (pos, radius) reaches into them. 0 draws every chunk.
+    float cull_distance = 0.0f;
+    std::vector<glm::vec4> far_lights;
+
+    // chunks outside of view_proj or behind the walls around the eye aren't
+    // drawn either. Off for views that don't have one.
+    bool cull_occluded = false;
+    glm::mat4 view_proj = glm::mat4(1.0f);
+    std::vector<occluder_quad> occluders;
+    occlusion_buffer occlusion;
+
+    std::vector<uint8_t> lods;
+    std::vector<GLint> firsts;
+    std::vector<GLsizei> counts;
+
+    // drawn by the last render.
+    uint64_t triangles = 0;
+
+    void set_camera(glm::vec3 eye, float fovy, int viewport_height);
+};
+
+// views of a split screen drawn together, as many as the shaders take.
+#define MAZE_MAX_VIEWS 4
+
+/**
+ * @brief One draw of glMultiDrawArraysIndirect.
+ */
+struct draw_arrays_command {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first;
+    GLuint base_instance;
+};
+
+/**
+ * @brief The views of a split screen, drawn by maze::render_views. Every
+ * view still picks its own lods, only the draw is shared.
+ */
+struct maze_view_set {
+    std::vector<maze_view> views;
+
+    std::vector<draw_arrays_command> commands;
+    GLuint indirect_buffer = 0;
+
+    uint64_t triangles() const;
+};
+
+class maze_streamer;
+#endif
+
 class maze {
-	uint32_t data[MAZE_WIDTH][MAZE_HEIGHT][MAZE_LENGTH];
-    std::vector<glm::vec3> vertices;
+    glm::ivec3 size;
+    glm::ivec3 chunks;
+    uint32_t seed;
+    float wall_size = 0.0f;
+
+    // cells points either to cell_storage or into the mapped file, same for
+    // mesh/chunk_ranges and vertices/chunk_table.
+    uint8_t* cells;
+    std::vector<uint8_t> cell_storage;
+
+    const maze_vertex* mesh = nullptr;
+    size_t mesh_vertices = 0;
+    std::vector<maze_vertex> vertices;
+
+    const maze_chunk* chunk_ranges = nullptr;
+    std::vector<maze_chunk> chunk_table;
+
+    maze_file file;
+
+    memory_account cells_memory{MEMORY_CELLS};
+    memory_account mesh_memory{MEMORY_MESH};
+
+    void account_mesh();
+
+#ifndef IT_NO_GL
+    memory_account gpu_memory{MEMORY_GPU_MESH};
+
+    // set when only the chunks around the camera are kept resident.
+    std::unique_ptr<maze_streamer> streamer;
+
     GLuint vao;
     GLuint vbo;
+    // 0, 1, ... per instance, the view of a draw is its base instance.
+    GLuint view_vbo;
+
+    friend class maze_streamer;
+#endif
 
 public:
-	maze();
+	maze(glm::ivec3 size = glm::ivec3(MAZE_WIDTH, MAZE_HEIGHT, MAZE_LENGTH),
+	     uint32_t seed = 0);
+
+	~maze();
+
+	maze(const maze&) = delete;
+	maze& operator=(const maze&) = delete;
+
 	void create_paths(glm::ivec3 start);
 	bool in_bounds(glm::ivec3 p) const;
 	void gen_vertices(float wall_size);
-	void print() const;
+	void print(std::FILE* out = stdout) const;
+
+	// Checks that every passage is open from both sides and that the
+	// passages form a single spanning tree. Says what is wrong on stderr.
+	bool validate() const;
+
+	bool save(const char* path, bool with_mesh) const;
+	bool load(const char* path);
+	// The cpu copy is freed once init_gl uploaded it, save before.
+	bool has_mesh() const { return mesh != nullptr; }
+	size_t get_mesh_vertices() const { return mesh_vertices; }
+
+#ifndef IT_NO_GL
+	// Needs a loaded maze. From then on init_gl/render only deal with the
+	// chunks within radius chunks of the camera passed to stream().
+	bool start_streaming(int radius, size_t budget_bytes);
+	// Returns if the chunks drawn changed. stream_pending is true while
+	// chunks it asked for are still being loaded.
+	bool stream(glm::vec3 cam_pos);
+	bool stream_pending() const;
+#endif
+
+	glm::ivec3 get_size() const { return size; }
+	uint32_t get_seed() const { return seed; }
+	float get_wall_size() const { return wall_size; }
+
+	size_t index(glm::ivec3 p) const {
+		const int mask = MAZE_CHUNK_SIZE - 1;
+		size_t chunk = ((size_t)(p.z >> MAZE_CHUNK_SHIFT) * chunks.y
+				+ (p.y >> MAZE_CHUNK_SHIFT)) * chunks.x
+				+ (p.x >> MAZE_CHUNK_SHIFT);
+		return chunk * MAZE_CHUNK_CELLS
+			+ ((p.z & mask) << (2 * MAZE_CHUNK_SHIFT))
+			+ ((p.y & mask) << MAZE_CHUNK_SHIFT)
+			+ (p.x & mask);
+	}
+
+	uint8_t cell(glm::ivec3 p) const { return cells[index(p)]; }
+
+	// Copies the cells of chunk and one cell around it into apron, x
+	// fastest, for mesh_chunk.
+	void gather_apron(glm::ivec3 chunk, uint8_t* apron) const;
+
+#ifndef IT_NO_GL
+	// lod of the chunk at chunk (with the given index) seen from view, -1
+	// when it is past the view's cull_distance, or occluded.
+	int chunk_lod(maze_view& view, size_t index, glm::ivec3 chunk) const;
+
+	// Merged runs of the walls around the view's eye into its occluders,
+	// rasterized into its occlusion buffer. Before its chunk_lods.
+	void build_occlusion(maze_view& view) const;
+
+	// The ranges of the mesh of the chunk at lod to draw for view, adjacent
+	// ones merged, into firsts and counts (room for MAZE_CHUNK_BLOCKS of
+	// them). All of the lod but for lod 0 with occlusion culling, then the
+	// blocks view may see. Returns how many there are.
+	int chunk_runs(const maze_view& view, const maze_chunk& ranges, glm::ivec3 chunk, int lod,
+	               uint32_t* firsts, uint32_t* counts) const;
+
+    // Uploads the mesh and frees (or for a loaded maze, unmaps) the cpu
+    // copy, the draws only need the chunk table.
     void init_gl();
-    void render() const;
+    void render(maze_view& view) const;
+
+    // Picks the lods of every view and draws them all with a single indirect
+    // multi draw, instance i being view i. The bound program has to send
+    // every view to its own viewport. Not for streamed mazes.
+    void render_views(maze_view_set& set) const;
+#endif
 };
 
 #endif
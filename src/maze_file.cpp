@@ -0,0 +1,218 @@
+#include "maze_file.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static uint64_t align_up(uint64_t offset) {
+    return (offset + MAZE_FILE_ALIGNMENT - 1) & ~(uint64_t)(MAZE_FILE_ALIGNMENT - 1);
+}
+
+maze_file::~maze_file() {
+    unmap();
+}
+
+#ifdef _WIN32
+
+bool maze_file::map(const char* path) {
+    unmap();
+
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::fprintf(stderr, "ERROR: Maze file: could not open %s\n", path);
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    GetFileSizeEx(file, &file_size);
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    CloseHandle(file);
+    if (!mapping) {
+        std::fprintf(stderr, "ERROR: Maze file: could not map %s\n", path);
+        return false;
+    }
+
+    base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    if (!base) {
+        CloseHandle(mapping);
+        std::fprintf(stderr, "ERROR: Maze file: could not map %s\n", path);
+        return false;
+    }
+
+    mapping_handle = mapping;
+    bytes = (size_t)file_size.QuadPart;
+    return true;
+}
+
+void maze_file::unmap() {
+    if (base) {
+        UnmapViewOfFile(base);
+        CloseHandle(mapping_handle);
+    }
+
+    base = nullptr;
+    mapping_handle = nullptr;
+    bytes = 0;
+}
+
+void maze_file::will_need(uint64_t offset, uint64_t length) const {
+    WIN32_MEMORY_RANGE_ENTRY range = { at(offset), (SIZE_T)length };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void maze_file::release(uint64_t offset, uint64_t length) const {
+    // the working set manager trims clean file backed pages on its own.
+    (void)offset;
+    (void)length;
+}
+
+#else
+
+bool maze_file::map(const char* path) {
+    unmap();
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        std::fprintf(stderr, "ERROR: Maze file: could not open %s\n", path);
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(maze_file_header)) {
+        std::fprintf(stderr, "ERROR: Maze file: %s is too small\n", path);
+        close(fd);
+        return false;
+    }
+
+    void* p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        std::fprintf(stderr, "ERROR: Maze file: could not map %s\n", path);
+        return false;
+    }
+
+    base = p;
+    bytes = st.st_size;
+    return true;
+}
+
+void maze_file::unmap() {
+    if (base)
+        munmap(base, bytes);
+
+    base = nullptr;
+    bytes = 0;
+}
+
+void maze_file::will_need(uint64_t offset, uint64_t length) const {
+    madvise(at(offset), length, MADV_WILLNEED);
+}
+
+void maze_file::release(uint64_t offset, uint64_t length) const {
+    uint64_t first = align_up(offset);
+    uint64_t last = (offset + length) & ~(uint64_t)(MAZE_FILE_ALIGNMENT - 1);
+
+    if (first < last)
+        madvise(at(first), last - first, MADV_DONTNEED);
+}
+
+#endif
+
+// offset + length can wrap, length is compared with what is left instead.
+static bool section_fits(uint64_t offset, uint64_t length, uint64_t total) {
+    return offset <= total && length <= total - offset;
+}
+
+const maze_file_header* maze_file::header() const {
+    const maze_file_header* h = (const maze_file_header*) base;
+
+    if (!h || h->magic != MAZE_FILE_MAGIC) {
+        std::fprintf(stderr, "ERROR: Maze file: bad magic\n");
+        return nullptr;
+    }
+
+    if (h->version != MAZE_FILE_VERSION) {
+        std::fprintf(
+                stderr,
+                "ERROR: Maze file: version %u, expected %u\n",
+                h->version,
+                MAZE_FILE_VERSION);
+        return nullptr;
+    }
+
+    if (!section_fits(h->cells_offset, h->cells_bytes, bytes) ||
+        !section_fits(h->chunks_offset, h->chunks_bytes, bytes) ||
+        !section_fits(h->mesh_offset, h->mesh_bytes, bytes)) {
+        std::fprintf(stderr, "ERROR: Maze file: truncated\n");
+        return nullptr;
+    }
+
+    return h;
+}
+
+uint8_t* maze_file::at(uint64_t offset) const {
+    return (uint8_t*) base + offset;
+}
+
+static bool write_section(std::FILE* f, uint64_t& written, uint64_t offset, maze_file_section section) {
+    if (!section.bytes)
+        return true;
+
+    // pad up to the section offset
+    static const uint8_t zeros[MAZE_FILE_ALIGNMENT] = {0};
+    uint64_t padding = offset - written;
+    if (std::fwrite(zeros, 1, padding, f) != padding)
+        return false;
+
+    written = offset + section.bytes;
+    return std::fwrite(section.data, 1, section.bytes, f) == section.bytes;
+}
+
+bool write_maze_file(const char* path,
+                     maze_file_header header,
+                     maze_file_section cells,
+                     maze_file_section chunks,
+                     maze_file_section mesh) {
+    header.magic = MAZE_FILE_MAGIC;
+    header.version = MAZE_FILE_VERSION;
+
+    header.cells_offset = align_up(sizeof(maze_file_header));
+    header.cells_bytes = cells.bytes;
+    header.chunks_offset = align_up(header.cells_offset + cells.bytes);
+    header.chunks_bytes = chunks.bytes;
+    header.mesh_offset = mesh.bytes ? align_up(header.chunks_offset + chunks.bytes) : 0;
+    header.mesh_bytes = mesh.bytes;
+
+    if (mesh.bytes)
+        header.flags |= MAZE_FILE_HAS_MESH;
+    else
+        header.flags &= ~MAZE_FILE_HAS_MESH;
+
+    std::FILE* f = std::fopen(path, "wb");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Maze file: could not create %s\n", path);
+        return false;
+    }
+
+    uint64_t written = sizeof(header);
+    bool ok = std::fwrite(&header, sizeof(header), 1, f) == 1
+        && write_section(f, written, header.cells_offset, cells)
+        && write_section(f, written, header.chunks_offset, chunks)
+        && write_section(f, written, header.mesh_offset, mesh);
+
+    ok = (std::fclose(f) == 0) && ok;
+    if (!ok)
+        std::fprintf(stderr, "ERROR: Maze file: could not write %s\n", path);
+
+    return ok;
+}
@@ -0,0 +1,92 @@
+#ifndef IT_MAZE_FILE_H
+#define IT_MAZE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+
+// "MAZE" read as a little endian uint32_t.
+#define MAZE_FILE_MAGIC     0x455A414Du
+#define MAZE_FILE_VERSION   5
+
+// Every section starts on its own page, so it can be handed to the GPU (or
+// used as the cell array) straight from the mapping.
+#define MAZE_FILE_ALIGNMENT 4096
+
+#define MAZE_FILE_HAS_MESH  0x01
+
+/**
+ * @brief On disk header of a maze file. Lives at offset 0, everything else is
+ * found through the offsets in here. All offsets are multiples of
+ * MAZE_FILE_ALIGNMENT, a section with zero bytes is absent.
+ *
+ * Layout: header | cells (one byte of wall bits per cell, chunk bricked) |
+ * chunk table (maze_chunk per chunk) | mesh (maze_vertex array).
+ */
+struct maze_file_header {
+    uint32_t magic;
+    uint32_t version;
+    int32_t  size[3];
+    uint32_t seed;
+    uint32_t algorithm;
+    uint32_t chunk_size;
+    uint32_t flags;
+    float    wall_size;
+
+    uint64_t cells_offset;
+    uint64_t cells_bytes;
+    uint64_t chunks_offset;
+    uint64_t chunks_bytes;
+    uint64_t mesh_offset;
+    uint64_t mesh_bytes;
+};
+
+static_assert(sizeof(maze_file_header) == 88, "maze_file_header layout changed");
+
+/**
+ * @brief A maze file mapped into memory. The mapping is private and
+ * writable, edits to the cells are copy on write and never reach the file.
+ */
+class maze_file {
+    void* base = nullptr;
+    size_t bytes = 0;
+#ifdef _WIN32
+    void* mapping_handle = nullptr;
+#endif
+
+public:
+    maze_file() = default;
+    ~maze_file();
+
+    maze_file(const maze_file&) = delete;
+    maze_file& operator=(const maze_file&) = delete;
+
+    bool map(const char* path);
+    void unmap();
+
+    bool is_mapped() const { return base != nullptr; }
+    const maze_file_header* header() const;
+    uint8_t* at(uint64_t offset) const;
+
+    // hint the kernel that the range is about to be read front to back.
+    void will_need(uint64_t offset, uint64_t bytes) const;
+    // drop the whole pages inside the range from the resident set, they are
+    // read again from the file if touched later. Only for unmodified ranges.
+    void release(uint64_t offset, uint64_t bytes) const;
+};
+
+struct maze_file_section {
+    const void* data;
+    uint64_t bytes;
+};
+
+/**
+ * @brief Writes a maze file. The section offsets and sizes of the header are
+ * filled from the given sections, a mesh with zero bytes is left out.
+ */
+bool write_maze_file(const char* path,
+                     maze_file_header header,
+                     maze_file_section cells,
+                     maze_file_section chunks,
+                     maze_file_section mesh);
+
+#endif
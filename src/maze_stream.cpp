@@ -0,0 +1,333 @@
+#include "maze_stream.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+maze_streamer::maze_streamer(const maze& m, int radius, size_t budget) :
+    m(m), radius(radius), budget(budget) {
+    io_thread = std::thread(&maze_streamer::io_loop, this);
+    mesh_thread = std::thread(&maze_streamer::mesh_loop, this);
+}
+
+maze_streamer::~maze_streamer() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        quit = true;
+    }
+
+    wake_io.notify_all();
+    wake_mesh.notify_all();
+    io_thread.join();
+    mesh_thread.join();
+
+    for (const auto& [index, chunk] : resident)
+        forget(chunk);
+}
+
+void maze_streamer::forget(const resident_chunk& chunk) {
+    if (!chunk.ready)
+        return;
+
+    memory_add(MEMORY_CELLS, -(int64_t) chunk.cells.size());
+    memory_add(MEMORY_GPU_MESH, -(int64_t) (chunk.bytes - chunk.cells.size()));
+}
+
+void maze_streamer::init_gl() {
+    // every chunk has its own vbo, they are swapped in with glBindVertexBuffer
+    // so the attribute layout is only set once.
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    const GLuint maze_vertex_attrib_index = 0;
+    const GLuint maze_color_attrib_index = 1;
+    const GLuint maze_ao_attrib_index = 2;
+    const GLuint maze_material_attrib_index = 4;
+
+    glEnableVertexAttribArray(maze_vertex_attrib_index);
+    glEnableVertexAttribArray(maze_color_attrib_index);
+    glEnableVertexAttribArray(maze_ao_attrib_index);
+    glEnableVertexAttribArray(maze_material_attrib_index);
+
+    glVertexAttribFormat(maze_vertex_attrib_index, 3, GL_FLOAT, GL_FALSE,
+                         offsetof(maze_vertex, pos));
+    glVertexAttribFormat(maze_color_attrib_index, 3, GL_FLOAT, GL_FALSE,
+                         offsetof(maze_vertex, color));
+    glVertexAttribFormat(maze_ao_attrib_index, 2, GL_FLOAT, GL_FALSE,
+                         offsetof(maze_vertex, ao));
+    glVertexAttribIFormat(maze_material_attrib_index, 1, GL_UNSIGNED_INT,
+                          offsetof(maze_vertex, material));
+    glVertexAttribBinding(maze_vertex_attrib_index, 0);
+    glVertexAttribBinding(maze_color_attrib_index, 0);
+    glVertexAttribBinding(maze_ao_attrib_index, 0);
+    glVertexAttribBinding(maze_material_attrib_index, 0);
+}
+
+void maze_streamer::io_loop() {
+    trace_thread_name("stream io");
+    const uint8_t* file_base = m.file.at(0);
+
+    while (true) {
+        chunk_job job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake_io.wait(guard, [this] { return quit || !to_load.empty(); });
+            if (quit)
+                return;
+
+            job = std::move(to_load.front());
+            to_load.pop_front();
+
+            // start reading the next one while this one is copied
+            if (!to_load.empty())
+                m.file.will_need((m.cells - file_base) + to_load.front().index * MAZE_CHUNK_CELLS,
+                                 MAZE_CHUNK_CELLS);
+        }
+
+        TRACE_ZONE("stream load chunk");
+
+        // a chunk is exactly one page of the file
+        const uint8_t* src = m.cells + job.index * MAZE_CHUNK_CELLS;
+        job.cells.assign(src, src + MAZE_CHUNK_CELLS);
+
+        bool prebuilt = m.mesh != nullptr;
+        if (!prebuilt) {
+            // the ao of the walls on the chunk's faces needs the cells next
+            // to it, gathered before the chunk's page is dropped
+            job.apron.resize(MAZE_APRON_CELLS);
+            m.gather_apron(job.coord, job.apron.data());
+        }
+        m.file.release(src - file_base, MAZE_CHUNK_CELLS);
+
+        if (prebuilt) {
+            // the lods of a chunk are stored back to back
+            job.ranges = m.chunk_ranges[job.index];
+            uint32_t begin = job.ranges.first[0];
+            uint32_t end = job.ranges.first[MAZE_LODS - 1] + job.ranges.count[MAZE_LODS - 1];
+            for (int lod = 0; lod < MAZE_LODS; lod++)
+                job.ranges.first[lod] -= begin;
+
+            job.vertices.assign(m.mesh + begin, m.mesh + end);
+            m.file.release((const uint8_t*) (m.mesh + begin) - file_base,
+                           (end - begin) * sizeof(maze_vertex));
+        }
+
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            if (prebuilt)
+                to_upload.push_back(std::move(job));
+            else
+                to_mesh.push_back(std::move(job));
+        }
+
+        if (!prebuilt)
+            wake_mesh.notify_one();
+    }
+}
+
+void maze_streamer::mesh_loop() {
+    trace_thread_name("stream mesh");
+
+    while (true) {
+        chunk_job job;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake_mesh.wait(guard, [this] { return quit || !to_mesh.empty(); });
+            if (quit)
+                return;
+
+            job = std::move(to_mesh.front());
+            to_mesh.pop_front();
+        }
+
+        TRACE_ZONE("stream mesh chunk");
+        mesh_chunk_lods(job.apron.data(), job.coord, m.size, m.wall_size, job.vertices, job.ranges);
+        job.apron = std::vector<uint8_t>();
+
+        std::lock_guard<std::mutex> guard(lock);
+        to_upload.push_back(std::move(job));
+    }
+}
+
+void maze_streamer::request(glm::ivec3 center) {
+    glm::ivec3 lo = glm::max(center - radius, glm::ivec3(0));
+    glm::ivec3 hi = glm::min(center + radius, m.chunks - 1);
+
+    // nearest chunks first
+    std::vector<std::pair<int, glm::ivec3>> wanted;
+    for (int z = lo.z; z <= hi.z; z++) {
+        for (int y = lo.y; y <= hi.y; y++) {
+            for (int x = lo.x; x <= hi.x; x++) {
+                glm::ivec3 d = glm::ivec3(x, y, z) - center;
+                wanted.push_back({ d.x * d.x + d.y * d.y + d.z * d.z, glm::ivec3(x, y, z) });
+            }
+        }
+    }
+
+    std::sort(wanted.begin(), wanted.end(), [](const auto& a, const auto& b) {
+        return a.first < b.first;
+    });
+
+    bool over_budget = resident_bytes > budget;
+    bool queued = false;
+
+    std::lock_guard<std::mutex> guard(lock);
+
+    // loads that did not start yet and left the radius are dropped
+    if (center != last_center) {
+        auto gone = [&](const chunk_job& job) {
+            glm::ivec3 d = glm::abs(job.coord - center);
+            if (std::max(d.x, std::max(d.y, d.z)) <= radius)
+                return false;
+
+            resident.erase(job.index);
+            return true;
+        };
+        to_load.erase(std::remove_if(to_load.begin(), to_load.end(), gone), to_load.end());
+        last_center = center;
+    }
+
+    for (const auto& w : wanted) {
+        glm::ivec3 c = w.second;
+        size_t index = ((size_t)c.z * m.chunks.y + c.y) * m.chunks.x + c.x;
+
+        auto it = resident.find(index);
+        if (it != resident.end()) {
+            it->second.last_wanted = frame;
+            continue;
+        }
+
+        // only the wanted chunks are left and they don't fit, stop growing
+        if (over_budget)
+            continue;
+
+        resident[index].last_wanted = frame;
+        resident[index].coord = c;
+
+        chunk_job job;
+        job.index = index;
+        job.coord = c;
+        to_load.push_back(std::move(job));
+        queued = true;
+    }
+
+    if (queued)
+        wake_io.notify_one();
+}
+
+bool maze_streamer::upload() {
+    std::vector<chunk_job> jobs;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        while (!to_upload.empty() && jobs.size() < STREAM_UPLOADS_PER_FRAME) {
+            jobs.push_back(std::move(to_upload.front()));
+            to_upload.pop_front();
+        }
+    }
+
+    bool uploaded = false;
+    for (chunk_job& job : jobs) {
+        auto it = resident.find(job.index);
+        if (it == resident.end())
+            continue;
+
+        resident_chunk& chunk = it->second;
+        chunk.cells = std::move(job.cells);
+        chunk.ranges = job.ranges;
+
+        glGenBuffers(1, &chunk.vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, chunk.vbo);
+        glBufferData(
+                GL_ARRAY_BUFFER,
+                job.vertices.size() * sizeof(maze_vertex),
+                job.vertices.data(),
+                GL_STATIC_DRAW);
+
+        // the cpu side mesh is dropped with the job, only the cells stay
+        chunk.bytes = chunk.cells.size() + job.vertices.size() * sizeof(maze_vertex);
+        chunk.ready = true;
+        resident_bytes += chunk.bytes;
+        memory_add(MEMORY_CELLS, chunk.cells.size());
+        memory_add(MEMORY_GPU_MESH, job.vertices.size() * sizeof(maze_vertex));
+        uploaded = true;
+    }
+    return uploaded;
+}
+
+bool maze_streamer::evict(glm::ivec3 center) {
+    if (resident_bytes <= budget)
+        return false;
+
+    // the wanted chunks stay even when they don't fit, request() then stops
+    // loading more instead of them being loaded again every frame
+    std::vector<std::pair<uint64_t, size_t>> candidates;
+    for (const auto& [index, chunk] : resident) {
+        glm::ivec3 d = glm::abs(chunk.coord - center);
+        if (chunk.ready && std::max(d.x, std::max(d.y, d.z)) > radius)
+            candidates.push_back({ chunk.last_wanted, index });
+    }
+
+    std::sort(candidates.begin(), candidates.end());
+
+    bool evicted = false;
+    for (const auto& c : candidates) {
+        if (resident_bytes <= budget)
+            break;
+
+        resident_chunk& chunk = resident[c.second];
+        glDeleteBuffers(1, &chunk.vbo);
+        resident_bytes -= chunk.bytes;
+        forget(chunk);
+        resident.erase(c.second);
+        evicted = true;
+    }
+    return evicted;
+}
+
+bool maze_streamer::update(glm::vec3 cam_pos) {
+    TRACE_ZONE("stream update");
+    frame++;
+
+    // cells are centered on multiples of wall_size
+    glm::ivec3 cell = glm::ivec3(glm::floor(cam_pos / m.wall_size + 0.5f));
+    glm::ivec3 center = glm::clamp(cell, glm::ivec3(0), m.size - 1) / MAZE_CHUNK_SIZE;
+
+    bool uploaded = upload();
+    bool evicted = evict(center);
+    request(center);
+    return uploaded || evicted;
+}
+
+bool maze_streamer::pending() const {
+    for (const auto& [index, chunk] : resident) {
+        if (!chunk.ready)
+            return true;
+    }
+    return false;
+}
+
+void maze_streamer::render(maze_view& view) const {
+    glBindVertexArray(vao);
+    uint32_t firsts[MAZE_CHUNK_BLOCKS];
+    uint32_t counts[MAZE_CHUNK_BLOCKS];
+
+    for (const auto& [index, chunk] : resident) {
+        if (!chunk.ready)
+            continue;
+
+        int lod = m.chunk_lod(view, index, chunk.coord);
+        if (lod < 0)
+            continue;
+
+        int runs = m.chunk_runs(view, chunk.ranges, chunk.coord, lod, firsts, counts);
+        if (!runs)
+            continue;
+
+        glBindVertexBuffer(0, chunk.vbo, 0, sizeof(maze_vertex));
+        for (int r = 0; r < runs; r++) {
+            glDrawArrays(GL_TRIANGLES, firsts[r], counts[r]);
+            view.triangles += counts[r] / 3;
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#ifndef IT_MAZE_STREAM_H
+#define IT_MAZE_STREAM_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "maze.h"
+
+#define STREAM_DEFAULT_RADIUS    3
+#define STREAM_DEFAULT_BUDGET_MB 256
+
+// chunks uploaded to the GPU per frame, keeps the frame time flat while a
+// lot of chunks arrive at once.
+#define STREAM_UPLOADS_PER_FRAME 4
+
+/**
+ * @brief Keeps only the chunks around the camera of a mapped maze resident.
+ *
+ * An I/O thread pages the cells (or the prebuilt mesh) of wanted chunks in
+ * from the mapping, a mesh thread builds the missing meshes and the GL thread
+ * uploads finished chunks in update(). Chunks that are no longer wanted are
+ * evicted least recently used first once the resident bytes go over the
+ * budget.
+ */
+class maze_streamer {
+    struct chunk_job {
+        size_t index;
+        glm::ivec3 coord;
+        std::vector<uint8_t> cells;
+        // the cells and their neighbours, only when the chunk is meshed here
+        std::vector<uint8_t> apron;
+        std::vector<maze_vertex> vertices;
+        maze_chunk ranges;
+    };
+
+    struct resident_chunk {
+        bool ready = false;
+        glm::ivec3 coord;
+        uint64_t last_wanted = 0;
+        size_t bytes = 0;
+        std::vector<uint8_t> cells;
+        GLuint vbo = 0;
+        maze_chunk ranges;
+    };
+
+    const maze& m;
+    int radius;
+    size_t budget;
+
+    GLuint vao = 0;
+    uint64_t frame = 0;
+    glm::ivec3 last_center = glm::ivec3(-1);
+    size_t resident_bytes = 0;
+    std::unordered_map<size_t, resident_chunk> resident;
+
+    std::mutex lock;
+    std::condition_variable wake_io;
+    std::condition_variable wake_mesh;
+    std::deque<chunk_job> to_load;
+    std::deque<chunk_job> to_mesh;
+    std::deque<chunk_job> to_upload;
+    bool quit = false;
+
+    std::thread io_thread;
+    std::thread mesh_thread;
+
+    void io_loop();
+    void mesh_loop();
+    void request(glm::ivec3 center);
+    bool upload();
+    // evicts chunks outside the radius around center, never the ones in it.
+    bool evict(glm::ivec3 center);
+    // takes what an uploaded chunk holds off the memory counts.
+    void forget(const resident_chunk& chunk);
+
+public:
+    maze_streamer(const maze& m, int radius, size_t budget);
+    ~maze_streamer();
+
+    void init_gl();
+
+    // GL thread, once per frame. Returns if chunks were uploaded or evicted.
+    bool update(glm::vec3 cam_pos);
+    void render(maze_view& view) const;
+
+    // chunks requested that aren't drawn yet.
+    bool pending() const;
+
+    size_t get_resident_bytes() const { return resident_bytes; }
+    size_t get_resident_chunks() const { return resident.size(); }
+};
+
+#endif
@@ -0,0 +1,26 @@
+#include "memory.h"
+
+#include <atomic>
+
+static std::atomic<int64_t> used[MEMORY_COUNT];
+
+void memory_add(memory_use use, int64_t bytes) {
+    used[use].fetch_add(bytes, std::memory_order_relaxed);
+}
+
+uint64_t memory_bytes(memory_use use) {
+    int64_t bytes = used[use].load(std::memory_order_relaxed);
+    return bytes > 0 ? (uint64_t) bytes : 0;
+}
+
+const char* memory_name(memory_use use) {
+    switch (use) {
+    case MEMORY_CELLS:        return "cells";
+    case MEMORY_MESH:         return "mesh";
+    case MEMORY_LIGHTS:       return "lights";
+    case MEMORY_GPU_MESH:     return "gpu mesh";
+    case MEMORY_GPU_BUFFERS:  return "gpu buffers";
+    case MEMORY_GPU_TEXTURES: return "gpu textures";
+    default:                  return "what??";
+    }
+}
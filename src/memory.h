@@ -0,0 +1,57 @@
+#ifndef IT_MEMORY_H
+#define IT_MEMORY_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum memory_use {
+    // cpu: cells the maze owns (a loaded one maps its file) and the cells of
+    // streamed chunks
+    MEMORY_CELLS,
+    // vertices until they are uploaded, and the chunk tables
+    MEMORY_MESH,
+    // the light grid
+    MEMORY_LIGHTS,
+    // gpu: vertex buffers of the maze
+    MEMORY_GPU_MESH,
+    // the lights, draw commands, overlay text and quads
+    MEMORY_GPU_BUFFERS,
+    // render targets and the overlay's glyphs
+    MEMORY_GPU_TEXTURES,
+    MEMORY_COUNT
+};
+
+#define MEMORY_GPU_FIRST MEMORY_GPU_MESH
+
+/**
+ * @brief Counts bytes going to use, negative when they are freed. Any
+ * thread.
+ */
+void memory_add(memory_use use, int64_t bytes);
+
+// what use holds right now.
+uint64_t memory_bytes(memory_use use);
+const char* memory_name(memory_use use);
+
+/**
+ * @brief Bytes of one owner, told to memory_add as they change and given
+ * back when it goes away.
+ */
+class memory_account {
+    memory_use use;
+    size_t bytes = 0;
+
+public:
+    explicit memory_account(memory_use use) : use(use) {}
+    ~memory_account() { set(0); }
+
+    memory_account(const memory_account&) = delete;
+    memory_account& operator=(const memory_account&) = delete;
+
+    void set(size_t now) {
+        memory_add(use, (int64_t) now - (int64_t) bytes);
+        bytes = now;
+    }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include "minimap.h"
+#include "memory.h"
 #include "shaders.h"
 
 #include <cstdio>
@@ -56,14 +57,18 @@ int Minimap::create() {
     }
 
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // rgba8 and depth24 stencil8, 4 bytes a texel each
+    memory_add(MEMORY_GPU_TEXTURES, (int64_t) fb_width * fb_height * 8);
     return 1;
 }
 
 // TODO: remove these (program_ids, vao) to something sensible
-void Minimap::render(GLuint quad_vao, GLuint program_ids[], GLint mvp_location, const maze& m) {
+void Minimap::render(GLuint program_ids[], GLint mvp_location, const maze& m) {
 
     // TODO: should be temp
-    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, -30.0f), glm::vec3(20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::vec3 eye = glm::vec3(0.0f, 20.0f, -30.0f);
+    glm::mat4 view = glm::lookAt(eye, glm::vec3(20.0f), glm::vec3(0.0f, 1.0f, 0.0f));
 
     // TODO: REMOVE 16:9 from hardcode
     glm::mat4 proj = glm::perspective(
@@ -80,6 +85,7 @@ void Minimap::render(GLuint quad_vao, GLuint program_ids[], GLint mvp_location,
 
     // bind framebuffer
     glBindFramebuffer(GL_FRAMEBUFFER, fb_name);
+    glViewport(0, 0, fb_width, fb_height);
     glClearColor(0.3f, 0.3f, 0.8f, 0.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -87,12 +93,13 @@ void Minimap::render(GLuint quad_vao, GLuint program_ids[], GLint mvp_location,
     glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
     glUseProgram(program_ids[PROGRAM_BASIC]);
 
-    m.render();
+    this->view.set_camera(eye, glm::radians(90.0f), fb_height);
+    m.render(this->view);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+}
 
-
-    // draw minimap
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void Minimap::composite(GLuint quad_vao, GLuint program_ids[]) {
+    glBindFramebuffer(GL_FRAMEBUFFER, screen_fb);
 
     glDisable(GL_DEPTH_TEST);
     glUseProgram(program_ids[PROGRAM_MINIMAP]);
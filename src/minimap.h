@@ -18,6 +18,11 @@ public:
     int fb_width;
     int fb_height;
 
+    maze_view view;
+
+    // framebuffer the minimap is drawn onto, 0 is the window.
+    GLuint screen_fb = 0;
+
 
 
 public:
@@ -25,8 +30,13 @@ public:
 
     int create();
 
+    // draws the maze into the minimap framebuffer, the viewport is left at
+    // its size.
+    void render(GLuint program_ids[], GLint mvp_location, const maze& m);
+
     // TODO: change quad_vao to vao (lol)
-    void render(GLuint quad_vao, GLuint program_ids[], GLint mvp_location, const maze& m);
+    // draws the minimap onto screen_fb.
+    void composite(GLuint quad_vao, GLuint program_ids[]);
 };
 
 #endif
@@ -0,0 +1,275 @@
+#include "net.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+typedef int socklen_t;
+#define NET_INVALID   ((intptr_t) INVALID_SOCKET)
+#define NET_SOCKET(h) ((SOCKET) (h))
+
+// winsock has to be started once before the first socket
+static bool net_startup() {
+    static bool started = false;
+    if (!started) {
+        WSADATA data;
+        started = WSAStartup(MAKEWORD(2, 2), &data) == 0;
+    }
+    return started;
+}
+
+static void close_handle(intptr_t handle) {
+    closesocket(NET_SOCKET(handle));
+}
+
+static bool set_non_blocking(intptr_t handle) {
+    u_long on = 1;
+    return ioctlsocket(NET_SOCKET(handle), FIONBIO, &on) == 0;
+}
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define NET_INVALID   ((intptr_t) -1)
+#define NET_SOCKET(h) ((int) (h))
+
+static bool net_startup() {
+    return true;
+}
+
+static void close_handle(intptr_t handle) {
+    ::close(NET_SOCKET(handle));
+}
+
+static bool set_non_blocking(intptr_t handle) {
+    int flags = fcntl(NET_SOCKET(handle), F_GETFL, 0);
+    return flags != -1 && fcntl(NET_SOCKET(handle), F_SETFL, flags | O_NONBLOCK) == 0;
+}
+#endif
+
+bool parse_address(const char* s, uint16_t default_port, net_address& address) {
+    if (!net_startup())
+        return false;
+
+    char host[256];
+    int port = default_port;
+
+    const char* colon = std::strrchr(s, ':');
+    size_t length = colon ? (size_t) (colon - s) : std::strlen(s);
+    if (length == 0 || length >= sizeof(host)) {
+        std::fprintf(stderr, "ERROR: Net: bad address %s\n", s);
+        return false;
+    }
+    std::memcpy(host, s, length);
+    host[length] = '\0';
+
+    if (colon) {
+        char* end;
+        long value = std::strtol(colon + 1, &end, 10);
+        if (*end || value <= 0 || value > 65535) {
+            std::fprintf(stderr, "ERROR: Net: bad port in %s\n", s);
+            return false;
+        }
+        port = (int) value;
+    }
+
+    addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    addrinfo* result = nullptr;
+    if (getaddrinfo(host, nullptr, &hints, &result) != 0 || !result) {
+        std::fprintf(stderr, "ERROR: Net: could not resolve %s\n", host);
+        return false;
+    }
+
+    address.host = ntohl(((const sockaddr_in*) result->ai_addr)->sin_addr.s_addr);
+    address.port = (uint16_t) port;
+    freeaddrinfo(result);
+    return true;
+}
+
+udp_socket::~udp_socket() {
+    close();
+}
+
+bool udp_socket::open(uint16_t port) {
+    close();
+    if (!net_startup()) {
+        std::fprintf(stderr, "ERROR: Net: could not start winsock\n");
+        return false;
+    }
+
+    handle = (intptr_t) socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (handle == NET_INVALID) {
+        handle = -1;
+        std::fprintf(stderr, "ERROR: Net: could not create a socket\n");
+        return false;
+    }
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if (bind(NET_SOCKET(handle), (const sockaddr*) &addr, sizeof(addr)) != 0) {
+        std::fprintf(stderr, "ERROR: Net: could not bind port %u\n", port);
+        close();
+        return false;
+    }
+
+    if (!set_non_blocking(handle)) {
+        std::fprintf(stderr, "ERROR: Net: could not make the socket non-blocking\n");
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+void udp_socket::close() {
+    if (handle != -1)
+        close_handle(handle);
+    handle = -1;
+}
+
+uint16_t udp_socket::local_port() const {
+    sockaddr_in addr = {};
+    socklen_t length = sizeof(addr);
+    if (handle == -1 || getsockname(NET_SOCKET(handle), (sockaddr*) &addr, &length) != 0)
+        return 0;
+    return ntohs(addr.sin_port);
+}
+
+// xorshift, the same packets are lost every run
+bool udp_socket::lose() {
+    if (loss_percent <= 0)
+        return false;
+
+    loss_state ^= loss_state << 13;
+    loss_state ^= loss_state >> 17;
+    loss_state ^= loss_state << 5;
+    return (int) (loss_state % 100) < loss_percent;
+}
+
+bool udp_socket::send(const net_address& to, const uint8_t* data, size_t size) {
+    if (handle == -1)
+        return false;
+
+    bytes_sent += size;
+    if (lose())
+        return true;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(to.host);
+    addr.sin_port = htons(to.port);
+    return sendto(NET_SOCKET(handle), (const char*) data, (int) size, 0, (const sockaddr*) &addr, sizeof(addr)) == (int) size;
+}
+
+int udp_socket::receive(net_address& from, uint8_t* data, size_t capacity) {
+    if (handle == -1)
+        return -1;
+
+    for (;;) {
+        sockaddr_in addr = {};
+        socklen_t length = sizeof(addr);
+        int size = (int) recvfrom(NET_SOCKET(handle), (char*) data, (int) capacity, 0, (sockaddr*) &addr, &length);
+        // would block, or a previous send bounced (windows reports those here)
+        if (size < 0)
+            return -1;
+
+        bytes_received += size;
+        if (lose())
+            continue;
+
+        from.host = ntohl(addr.sin_addr.s_addr);
+        from.port = ntohs(addr.sin_port);
+        return size;
+    }
+}
+
+void net_writer::header(net_packet_type type) {
+    u16(NET_PROTOCOL_ID);
+    u8(type);
+}
+
+void net_writer::u8(uint8_t v) {
+    if (size >= capacity) {
+        overflow = true;
+        return;
+    }
+    data[size++] = v;
+}
+
+void net_writer::u16(uint16_t v) {
+    u8((uint8_t) v);
+    u8((uint8_t) (v >> 8));
+}
+
+void net_writer::u32(uint32_t v) {
+    u16((uint16_t) v);
+    u16((uint16_t) (v >> 16));
+}
+
+void net_writer::varint(uint32_t v) {
+    while (v >= 0x80) {
+        u8((uint8_t) (v | 0x80));
+        v >>= 7;
+    }
+    u8((uint8_t) v);
+}
+
+void net_writer::svarint(int32_t v) {
+    varint(((uint32_t) v << 1) ^ (uint32_t) (v >> 31));
+}
+
+bool net_reader::header(net_packet_type& type) {
+    if (u16() != NET_PROTOCOL_ID)
+        return false;
+    type = (net_packet_type) u8();
+    return !error;
+}
+
+uint8_t net_reader::u8() {
+    if (pos >= size) {
+        error = true;
+        return 0;
+    }
+    return data[pos++];
+}
+
+uint16_t net_reader::u16() {
+    uint16_t lo = u8();
+    return (uint16_t) (lo | (u8() << 8));
+}
+
+uint32_t net_reader::u32() {
+    uint32_t lo = u16();
+    return lo | ((uint32_t) u16() << 16);
+}
+
+uint32_t net_reader::varint() {
+    uint32_t v = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        uint8_t b = u8();
+        v |= (uint32_t) (b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return v;
+    }
+
+    error = true;
+    return 0;
+}
+
+int32_t net_reader::svarint() {
+    uint32_t v = varint();
+    return (int32_t) (v >> 1) ^ -(int32_t) (v & 1);
+}
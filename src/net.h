@@ -0,0 +1,113 @@
+#ifndef IT_NET_H
+#define IT_NET_H
+
+#include <cstddef>
+#include <cstdint>
+
+#define NET_DEFAULT_PORT 4242
+// every packet fits in one datagram on any path
+#define NET_MAX_PACKET   1200
+// first two bytes of every packet, bumped when the protocol changes so old
+// peers drop the packets instead of misreading them.
+#define NET_PROTOCOL_ID  0x6901
+// a peer that sent nothing for this long is gone.
+#define NET_TIMEOUT_SECONDS 10
+
+enum net_packet_type : uint8_t {
+    NET_CONNECT,
+    NET_WELCOME,
+    NET_REJECT,
+    NET_INPUT,
+    NET_SNAPSHOT,
+    NET_DISCONNECT,
+};
+
+/**
+ * @brief IPv4 address and port, in host byte order.
+ */
+struct net_address {
+    uint32_t host = 0;
+    uint16_t port = 0;
+
+    bool operator==(const net_address& other) const { return host == other.host && port == other.port; }
+};
+
+/**
+ * @brief Parses "host" or "host:port", host is a name or a dotted address.
+ */
+bool parse_address(const char* s, uint16_t default_port, net_address& address);
+
+/**
+ * @brief Non-blocking UDP socket.
+ */
+class udp_socket {
+    intptr_t handle = -1;
+    uint32_t loss_state = 0x9e3779b9u;
+
+    bool lose();
+
+public:
+    // percent of the packets sent and received that are dropped on purpose.
+    int loss_percent = 0;
+
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+
+    udp_socket() = default;
+    udp_socket(const udp_socket&) = delete;
+    udp_socket& operator=(const udp_socket&) = delete;
+    ~udp_socket();
+
+    // port 0 takes any free one.
+    bool open(uint16_t port);
+    void close();
+    uint16_t local_port() const;
+
+    bool send(const net_address& to, const uint8_t* data, size_t size);
+    // size of the packet, -1 when there is none waiting.
+    int receive(net_address& from, uint8_t* data, size_t capacity);
+};
+
+/**
+ * @brief Packs a packet into data. Integers go little endian, varints seven
+ * bits per byte and signed ones zigzagged first, so small deltas take one
+ * byte. Writing past capacity sets overflow and drops the rest.
+ */
+struct net_writer {
+    uint8_t* data;
+    size_t capacity;
+    size_t size = 0;
+    bool overflow = false;
+
+    net_writer(uint8_t* data, size_t capacity) : data(data), capacity(capacity) {}
+
+    void header(net_packet_type type);
+    void u8(uint8_t v);
+    void u16(uint16_t v);
+    void u32(uint32_t v);
+    void varint(uint32_t v);
+    void svarint(int32_t v);
+};
+
+/**
+ * @brief Reads what net_writer wrote. Reading past the end sets error and
+ * returns zeros.
+ */
+struct net_reader {
+    const uint8_t* data;
+    size_t size;
+    size_t pos = 0;
+    bool error = false;
+
+    net_reader(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    // false for packets of another protocol.
+    bool header(net_packet_type& type);
+    uint8_t u8();
+    uint16_t u16();
+    uint32_t u32();
+    uint32_t varint();
+    int32_t svarint();
+};
+
+#endif
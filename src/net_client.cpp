@@ -0,0 +1,253 @@
+#include "net_client.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+// how much of the difference a snapshot moves the server clock estimate by.
+#define NET_CLOCK_SMOOTHING 0.05
+
+// the clock in simulation ticks, the unit of the server's.
+static double clock_ticks(int64_t time) {
+    return time * 1e-9 * SIM_TICK_RATE;
+}
+
+net_client::~net_client() {
+    disconnect();
+}
+
+bool net_client::connect(const net_address& address) {
+    if (!socket.open(0))
+        return false;
+
+    server = address;
+    uint32_t nonce = std::random_device()();
+
+    int64_t start = sim_clock();
+    int64_t last_try = 0;
+    while (sim_clock() - start < NET_CONNECT_TIMEOUT_MS * 1000000ll) {
+        if (!last_try || sim_clock() - last_try > NET_CONNECT_RETRY_MS * 1000000ll) {
+            net_writer w(packet, sizeof(packet));
+            w.header(NET_CONNECT);
+            w.u32(nonce);
+            socket.send(server, packet, w.size);
+            last_try = sim_clock();
+        }
+
+        net_address from;
+        int packet_size;
+        while ((packet_size = socket.receive(from, packet, sizeof(packet))) >= 0) {
+            net_reader r(packet, packet_size);
+            net_packet_type type;
+            if (!(from == server) || !r.header(type))
+                continue;
+
+            if (type == NET_REJECT) {
+                std::fprintf(stderr, "ERROR: Net: the server is full\n");
+                return false;
+            }
+            if (type != NET_WELCOME)
+                continue;
+
+            uint8_t welcome_id = r.u8();
+            seed = r.u32();
+            maze_size.x = (int) r.varint();
+            maze_size.y = (int) r.varint();
+            maze_size.z = (int) r.varint();
+            if (r.error || welcome_id >= NET_MAX_PLAYERS ||
+                maze_size.x <= 0 || maze_size.y <= 0 || maze_size.z <= 0) {
+                continue;
+            }
+
+            id = welcome_id;
+            connected = true;
+            latest_time = sim_clock();
+            return true;
+        }
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    std::fprintf(stderr, "ERROR: Net: no answer from the server\n");
+    return false;
+}
+
+void net_client::disconnect() {
+    if (connected) {
+        net_writer w(packet, sizeof(packet));
+        w.header(NET_DISCONNECT);
+        socket.send(server, packet, w.size);
+        connected = false;
+    }
+    socket.close();
+}
+
+void net_client::receive(int64_t now) {
+    net_address from;
+    int packet_size;
+    while ((packet_size = socket.receive(from, packet, sizeof(packet))) >= 0) {
+        net_reader r(packet, packet_size);
+        net_packet_type type;
+        if (!(from == server) || !r.header(type) || type != NET_SNAPSHOT)
+            continue;
+
+        uint32_t tick = r.u32();
+        uint32_t base_tick = r.u32();
+        uint32_t last_seq = r.u32();
+        if (r.error || tick <= latest_tick)
+            continue;
+
+        // a delta of a snapshot that never arrived can't be read, the acks
+        // make the server send one of an older one
+        const snapshot* base = nullptr;
+        if (base_tick) {
+            base = &received[(base_tick / NET_SNAPSHOT_INTERVAL) % NET_SNAPSHOT_HISTORY];
+            if (base->tick != base_tick)
+                continue;
+        }
+
+        snapshot decoded;
+        if (!read_snapshot(r, base, decoded))
+            continue;
+        decoded.tick = tick;
+        received[(tick / NET_SNAPSHOT_INTERVAL) % NET_SNAPSHOT_HISTORY] = decoded;
+        latest_tick = tick;
+        latest_time = now;
+
+        const net_player* own = decoded.find(id);
+        if (own) {
+            server_player = *own;
+            server_seq = last_seq;
+            server_fresh = true;
+        }
+
+        // snapshots arrive late by the latency and then some jitter
+        double offset = tick - clock_ticks(now);
+        tick_offset = synced ? tick_offset + (offset - tick_offset) * NET_CLOCK_SMOOTHING : offset;
+        synced = true;
+    }
+}
+
+void net_client::reconcile(player_state& p) {
+    if (!server_fresh)
+        return;
+    server_fresh = false;
+
+    // nothing applied yet, the server has it where it spawned
+    if (server_seq == 0 || server_seq <= acked_seq || server_seq >= next_seq)
+        return;
+    acked_seq = server_seq;
+
+    bool replay = next_seq - server_seq <= NET_COMMAND_HISTORY;
+    if (replay && results[server_seq % NET_COMMAND_HISTORY] == server_player)
+        return;
+
+    TRACE_ZONE("net reconcile");
+    corrections++;
+
+    // from where the server has it, the commands it hasn't seen yet again
+    player_state s = p;
+    predicted = server_player;
+    dequantize_player(predicted, s);
+    for (uint32_t seq = server_seq + 1; replay && seq < next_seq; seq++) {
+        net_step(s, predicted, commands[seq % NET_COMMAND_HISTORY]);
+        results[seq % NET_COMMAND_HISTORY] = predicted;
+    }
+
+    s.mouse_consumed = p.mouse_consumed;
+    p = s;
+}
+
+void net_client::send_input() {
+    uint32_t newest = next_seq - 1;
+    int count = (int) std::min<uint32_t>(NET_INPUT_REDUNDANCY, newest - acked_seq);
+
+    net_writer w(packet, sizeof(packet));
+    w.header(NET_INPUT);
+    w.u32(latest_tick);
+    w.u32(newest);
+    w.u8((uint8_t) count);
+    for (int i = 0; i < count; i++) {
+        const net_command& cmd = commands[(newest - i) % NET_COMMAND_HISTORY];
+        w.u8(cmd.held);
+        w.svarint(cmd.dx);
+        w.svarint(cmd.dy);
+    }
+    socket.send(server, packet, w.size);
+}
+
+void net_client::tick(player_state& p, uint32_t held, glm::ivec2 dmouse) {
+    TRACE_ZONE("net tick");
+
+    if (!spawned) {
+        glm::ivec2 consumed = p.mouse_consumed;
+        net_spawn(p, predicted, id);
+        p.mouse_consumed = consumed;
+        spawned = true;
+    }
+
+    receive(sim_clock());
+    reconcile(p);
+
+    net_command cmd;
+    cmd.held = (uint8_t) held;
+    cmd.dx = (int16_t) glm::clamp(dmouse.x, -32768, 32767);
+    cmd.dy = (int16_t) glm::clamp(dmouse.y, -32768, 32767);
+
+    uint32_t seq = next_seq++;
+    commands[seq % NET_COMMAND_HISTORY] = cmd;
+
+    // all of the mouse counts as consumed, even past what a command holds
+    glm::ivec2 consumed = p.mouse_consumed + dmouse;
+    net_step(p, predicted, cmd);
+    p.mouse_consumed = consumed;
+    results[seq % NET_COMMAND_HISTORY] = predicted;
+
+    if (seq % NET_INPUT_INTERVAL == 0)
+        send_input();
+}
+
+int net_client::remote_players(int64_t time, glm::vec3* positions, int capacity) const {
+    if (!synced)
+        return 0;
+
+    // the snapshots right before and after the time drawn
+    double tick = clock_ticks(time) + tick_offset - NET_INTERP_TICKS;
+    const snapshot* before = nullptr;
+    const snapshot* after = nullptr;
+    for (const snapshot& s : received) {
+        if (!s.tick)
+            continue;
+        if (s.tick <= tick && (!before || s.tick > before->tick))
+            before = &s;
+        if (s.tick > tick && (!after || s.tick < after->tick))
+            after = &s;
+    }
+
+    // past the newest one they stay where it has them
+    const snapshot* to = after ? after : before;
+    if (!to)
+        return 0;
+    float alpha = before && after ? (float) ((tick - before->tick) / (after->tick - before->tick)) : 1.0f;
+
+    int count = 0;
+    for (int i = 0; i < to->count && count < capacity; i++) {
+        const net_player& q = to->players[i];
+        if (q.id == id)
+            continue;
+
+        glm::vec3 pos = glm::vec3(q.pos[0], q.pos[1], q.pos[2]) / NET_POS_SCALE;
+        const net_player* from = before && after ? before->find(q.id) : nullptr;
+        if (from)
+            pos = glm::mix(glm::vec3(from->pos[0], from->pos[1], from->pos[2]) / NET_POS_SCALE, pos, alpha);
+        positions[count++] = pos;
+    }
+    return count;
+}
+
+bool net_client::lost(int64_t time) const {
+    return connected && time - latest_time > NET_TIMEOUT_SECONDS * 1000000000ll;
+}
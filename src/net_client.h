@@ -0,0 +1,99 @@
+#ifndef IT_NET_CLIENT_H
+#define IT_NET_CLIENT_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#include "net.h"
+#include "snapshot.h"
+
+// ticks between two input packets. Each one carries the commands the server
+// hasn't acknowledged, up to NET_INPUT_REDUNDANCY, so a lost packet is made
+// up for by the next ones.
+#define NET_INPUT_INTERVAL      2
+// commands kept to predict again from a correction.
+#define NET_COMMAND_HISTORY     128
+// the other players are drawn this many server ticks in the past, so there
+// is a snapshot on both sides of the time drawn even when one is lost.
+#define NET_INTERP_TICKS        12
+#define NET_CONNECT_TIMEOUT_MS  3000
+#define NET_CONNECT_RETRY_MS    100
+
+/**
+ * @brief The client end of a networked game. Moves its player right away
+ * from its own input (prediction) and sends the input to the server; when a
+ * snapshot says the server ended somewhere else after the same command, the
+ * player is put there and the newer commands are applied again
+ * (reconciliation). The other players are interpolated between snapshots.
+ */
+class net_client {
+    udp_socket socket;
+    net_address server;
+    bool connected = false;
+    uint8_t id = 0;
+
+    // the player given to tick always sits on predicted.
+    net_player predicted;
+    bool spawned = false;
+
+    // by sequence number, from 1, and where each one left the player.
+    uint32_t next_seq = 1;
+    net_command commands[NET_COMMAND_HISTORY];
+    net_player results[NET_COMMAND_HISTORY];
+
+    // received by tick / NET_SNAPSHOT_INTERVAL, deltas are decoded from them.
+    snapshot received[NET_SNAPSHOT_HISTORY];
+    uint32_t latest_tick = 0;
+    int64_t latest_time = 0;
+
+    // the server's player after command server_seq, not checked yet.
+    net_player server_player;
+    uint32_t server_seq = 0;
+    bool server_fresh = false;
+    uint32_t acked_seq = 0;
+
+    // server tick minus the local clock in ticks, smoothed over snapshots.
+    double tick_offset = 0.0;
+    bool synced = false;
+
+    uint8_t packet[NET_MAX_PACKET];
+
+    void receive(int64_t now);
+    void reconcile(player_state& p);
+    void send_input();
+
+public:
+    // the maze the server plays in.
+    uint32_t seed = 0;
+    glm::ivec3 maze_size = glm::ivec3(0);
+
+    // predictions the server disagreed with, after lost packets.
+    uint64_t corrections = 0;
+
+    ~net_client();
+
+    // waits for the server to let it in, up to NET_CONNECT_TIMEOUT_MS.
+    bool connect(const net_address& address);
+    void disconnect();
+
+    /**
+     * @brief One simulation tick of the player: applies the snapshots that
+     * came in, then moves p by held and dmouse (see step_player) and sends
+     * the command.
+     */
+    void tick(player_state& p, uint32_t held, glm::ivec2 dmouse);
+
+    // where the other players are at time (steady clock, ns), up to
+    // capacity of them. Returns how many.
+    int remote_players(int64_t time, glm::vec3* positions, int capacity) const;
+
+    // no snapshot for NET_TIMEOUT_SECONDS.
+    bool lost(int64_t time) const;
+
+    uint8_t get_id() const { return id; }
+    uint64_t bytes_sent() const { return socket.bytes_sent; }
+    uint64_t bytes_received() const { return socket.bytes_received; }
+};
+
+#endif
@@ -0,0 +1,230 @@
+#include "net_server.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#define ADDRESS_FORMAT "%u.%u.%u.%u:%u"
+#define ADDRESS_ARGS(a) \
+    (a).host >> 24, ((a).host >> 16) & 0xFF, ((a).host >> 8) & 0xFF, (a).host & 0xFF, (a).port
+
+bool net_server::start(uint16_t port, uint32_t maze_seed, glm::ivec3 maze_size) {
+    seed = maze_seed;
+    size = maze_size;
+    return socket.open(port);
+}
+
+int net_server::players() const {
+    int count = 0;
+    for (const net_peer& peer : peers)
+        count += peer.connected;
+    return count;
+}
+
+void net_server::step() {
+    TRACE_ZONE("server tick");
+    int64_t now = sim_clock();
+    tick++;
+
+    receive(now);
+
+    for (int id = 0; id < NET_MAX_PLAYERS; id++) {
+        net_peer& peer = peers[id];
+        if (peer.connected && now - peer.last_heard > NET_TIMEOUT_SECONDS * 1000000000ll) {
+            std::printf("player %d timed out\n", id);
+            peer.connected = false;
+        }
+    }
+
+    for (net_peer& peer : peers) {
+        if (peer.connected)
+            apply_queued(peer);
+    }
+
+    client_ticks += players();
+
+    if (tick % NET_SNAPSHOT_INTERVAL == 0) {
+        for (int id = 0; id < NET_MAX_PLAYERS; id++) {
+            if (peers[id].connected)
+                send_snapshot(id);
+        }
+    }
+}
+
+void net_server::receive(int64_t now) {
+    net_address from;
+    int packet_size;
+    while ((packet_size = socket.receive(from, packet, sizeof(packet))) >= 0) {
+        net_reader r(packet, packet_size);
+        net_packet_type type;
+        if (!r.header(type))
+            continue;
+
+        if (type == NET_CONNECT) {
+            connect(from, r, now);
+            continue;
+        }
+
+        net_peer* peer = nullptr;
+        for (net_peer& p : peers) {
+            if (p.connected && p.address == from)
+                peer = &p;
+        }
+        if (!peer)
+            continue;
+
+        peer->last_heard = now;
+        if (type == NET_INPUT) {
+            apply_input(*peer, r);
+        } else if (type == NET_DISCONNECT) {
+            std::printf("player %d left\n", (int) (peer - peers));
+            peer->connected = false;
+        }
+    }
+}
+
+void net_server::connect(const net_address& from, net_reader& r, int64_t now) {
+    uint32_t nonce = r.u32();
+    if (r.error)
+        return;
+
+    // the welcome got lost and the client asks again, or it restarted
+    int id = -1;
+    bool again = false;
+    for (int i = 0; i < NET_MAX_PLAYERS; i++) {
+        if (peers[i].connected && peers[i].address == from) {
+            id = i;
+            again = peers[i].nonce == nonce;
+        }
+    }
+    for (int i = 0; i < NET_MAX_PLAYERS && id < 0; i++) {
+        if (!peers[i].connected)
+            id = i;
+    }
+
+    net_writer w(packet, sizeof(packet));
+    if (id < 0) {
+        w.header(NET_REJECT);
+        socket.send(from, packet, w.size);
+        return;
+    }
+
+    net_peer& peer = peers[id];
+    if (!again) {
+        peer = net_peer();
+        peer.connected = true;
+        peer.address = from;
+        peer.nonce = nonce;
+        net_spawn(peer.state, peer.q, (uint8_t) id);
+        std::printf("player %d joined from " ADDRESS_FORMAT "\n", id, ADDRESS_ARGS(from));
+    }
+    peer.last_heard = now;
+
+    w.header(NET_WELCOME);
+    w.u8((uint8_t) id);
+    w.u32(seed);
+    w.varint((uint32_t) size.x);
+    w.varint((uint32_t) size.y);
+    w.varint((uint32_t) size.z);
+    socket.send(from, packet, w.size);
+}
+
+void net_server::apply_input(net_peer& peer, net_reader& r) {
+    uint32_t ack = r.u32();
+    uint32_t newest = r.u32();
+    int count = r.u8();
+    if (count > NET_INPUT_REDUNDANCY || newest < (uint32_t) count)
+        return;
+
+    net_command commands[NET_INPUT_REDUNDANCY];
+    for (int i = 0; i < count; i++) {
+        commands[i].held = r.u8();
+        commands[i].dx = (int16_t) glm::clamp(r.svarint(), -32768, 32767);
+        commands[i].dy = (int16_t) glm::clamp(r.svarint(), -32768, 32767);
+    }
+    if (r.error)
+        return;
+
+    // acks come out of order too, and only for snapshots that were sent
+    if (ack > peer.acked_tick && ack <= tick)
+        peer.acked_tick = ack;
+
+    // newest first, the ones queued already are resent in case they were
+    // lost
+    for (int i = count - 1; i >= 0; i--) {
+        uint32_t seq = newest - i;
+        if (seq <= peer.queued_seq)
+            continue;
+        if (peer.queued_count == NET_INPUT_QUEUE)
+            break;
+
+        peer.queued[peer.queued_count++] = { seq, commands[i] };
+        peer.queued_seq = seq;
+    }
+}
+
+void net_server::apply_queued(net_peer& peer) {
+    peer.credit = std::min(peer.credit + 1, NET_INPUT_CATCH_UP);
+
+    int applied = 0;
+    while (applied < peer.queued_count && peer.credit > 0) {
+        const net_queued_command& c = peer.queued[applied++];
+        net_step(peer.state, peer.q, c.command);
+        peer.last_seq = c.seq;
+        peer.credit--;
+    }
+
+    std::copy(peer.queued + applied, peer.queued + peer.queued_count, peer.queued);
+    peer.queued_count -= applied;
+}
+
+void net_server::send_snapshot(int id) {
+    net_peer& peer = peers[id];
+
+    // the client's own player and the ones nearest to it
+    struct candidate {
+        float distance;
+        uint8_t id;
+    };
+    candidate others[NET_MAX_PLAYERS];
+    int count = 0;
+    for (int i = 0; i < NET_MAX_PLAYERS; i++) {
+        if (i == id || !peers[i].connected)
+            continue;
+        glm::vec3 d = peers[i].state.cam_pos - peer.state.cam_pos;
+        others[count++] = { glm::dot(d, d), (uint8_t) i };
+    }
+
+    int nearest = std::min(count, NET_SNAPSHOT_PLAYERS - 1);
+    std::partial_sort(others, others + nearest, others + count,
+                      [](const candidate& a, const candidate& b) { return a.distance < b.distance; });
+
+    uint8_t ids[NET_SNAPSHOT_PLAYERS];
+    ids[0] = (uint8_t) id;
+    for (int i = 0; i < nearest; i++)
+        ids[i + 1] = others[i].id;
+    std::sort(ids, ids + nearest + 1);
+
+    snapshot& current = peer.sent[(tick / NET_SNAPSHOT_INTERVAL) % NET_SNAPSHOT_HISTORY];
+
+    // the base is overwritten by this one when the ack is that old
+    const snapshot* base = nullptr;
+    if (peer.acked_tick) {
+        const snapshot& acked = peer.sent[(peer.acked_tick / NET_SNAPSHOT_INTERVAL) % NET_SNAPSHOT_HISTORY];
+        if (acked.tick == peer.acked_tick && &acked != &current)
+            base = &acked;
+    }
+
+    current.tick = tick;
+    current.count = nearest + 1;
+    for (int i = 0; i < current.count; i++)
+        current.players[i] = peers[ids[i]].q;
+
+    net_writer w(packet, sizeof(packet));
+    w.header(NET_SNAPSHOT);
+    w.u32(tick);
+    w.u32(base ? base->tick : 0);
+    w.u32(peer.last_seq);
+    write_snapshot(w, base, current);
+    socket.send(peer.address, packet, w.size);
+}
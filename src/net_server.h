@@ -0,0 +1,95 @@
+#ifndef IT_NET_SERVER_H
+#define IT_NET_SERVER_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#include "net.h"
+#include "snapshot.h"
+
+// A peer earns one command a tick and saves up to this many for commands
+// that arrived late, so it never moves faster than a player on the server
+// would however many it sends.
+#define NET_INPUT_CATCH_UP 4
+// commands a peer can have waiting, newer ones are left for it to resend.
+#define NET_INPUT_QUEUE    16
+
+/**
+ * @brief A command received but not applied yet.
+ */
+struct net_queued_command {
+    uint32_t seq;
+    net_command command;
+};
+
+/**
+ * @brief A connected client as the server sees it.
+ */
+struct net_peer {
+    bool connected = false;
+    net_address address;
+    // picked by the client, a CONNECT with another one is a new session.
+    uint32_t nonce = 0;
+
+    // the player, always where q puts it.
+    player_state state;
+    net_player q;
+
+    // newest command applied, they are numbered from 1.
+    uint32_t last_seq = 0;
+    // received and waiting for a tick, oldest first, and the newest of them
+    // (last_seq when there are none).
+    net_queued_command queued[NET_INPUT_QUEUE];
+    int queued_count = 0;
+    uint32_t queued_seq = 0;
+    // commands it may apply, see NET_INPUT_CATCH_UP.
+    int credit = 0;
+    // newest snapshot the client has, the next one is a delta of it.
+    uint32_t acked_tick = 0;
+    int64_t last_heard = 0;
+
+    // what was sent, by tick / NET_SNAPSHOT_INTERVAL.
+    snapshot sent[NET_SNAPSHOT_HISTORY];
+};
+
+/**
+ * @brief The authoritative side of a networked game. Players only move by
+ * the commands their clients send, queued as they arrive and applied about
+ * one a tick. Every NET_SNAPSHOT_INTERVAL ticks each client gets the
+ * players nearest to it as a delta of the last snapshot it acknowledged.
+ *
+ * The maze is never sent, only its seed and size, clients generate it.
+ */
+class net_server {
+    uint32_t seed = 0;
+    glm::ivec3 size = glm::ivec3(0);
+    uint32_t tick = 0;
+
+    net_peer peers[NET_MAX_PLAYERS];
+    uint8_t packet[NET_MAX_PACKET];
+
+    void receive(int64_t now);
+    void connect(const net_address& from, net_reader& r, int64_t now);
+    void apply_input(net_peer& peer, net_reader& r);
+    // applies the queued commands of peer its credit allows.
+    void apply_queued(net_peer& peer);
+    void send_snapshot(int id);
+
+public:
+    udp_socket socket;
+
+    // ticks summed over the connected clients, what the traffic is averaged
+    // over.
+    uint64_t client_ticks = 0;
+
+    // port 0 takes any free one.
+    bool start(uint16_t port, uint32_t maze_seed, glm::ivec3 maze_size);
+
+    // one tick, called SIM_TICK_RATE times a second.
+    void step();
+
+    int players() const;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include "occlusion.h"
+#include "jobs.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Keeps the part of the polygon where dot(plane, v) >= 0, returns how many
+// vertices out has.
+static int clip_polygon(const glm::vec4* poly, int count, glm::vec4 plane, glm::vec4* out) {
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+        const glm::vec4& a = poly[i];
+        const glm::vec4& b = poly[(i + 1) % count];
+        float da = glm::dot(plane, a);
+        float db = glm::dot(plane, b);
+
+        if (da >= 0.0f)
+            out[n++] = a;
+        if ((da >= 0.0f) != (db >= 0.0f))
+            out[n++] = a + (b - a) * (da / (da - db));
+    }
+    return n;
+}
+
+// the edge from a to b as a x + b y + c, positive on the left of it.
+static glm::vec3 edge_function(glm::vec2 a, glm::vec2 b) {
+    return glm::vec3(a.y - b.y, b.x - a.x, a.x * b.y - b.x * a.y);
+}
+
+// In clip space the view is -w <= x, y <= w and the near plane z >= -w, past
+// it w is positive.
+static const glm::vec4 view_planes[] = {
+    glm::vec4(0.0f, 0.0f, 1.0f, 1.0f),
+    glm::vec4(1.0f, 0.0f, 0.0f, 1.0f),
+    glm::vec4(-1.0f, 0.0f, 0.0f, 1.0f),
+    glm::vec4(0.0f, 1.0f, 0.0f, 1.0f),
+    glm::vec4(0.0f, -1.0f, 0.0f, 1.0f),
+};
+
+void occlusion_buffer::setup(const occluder_quad& quad) {
+    glm::vec4 poly[OCCLUSION_CLIP_VERTICES];
+    glm::vec4 clipped[OCCLUSION_CLIP_VERTICES];
+    int count = 4;
+    for (int i = 0; i < 4; i++)
+        poly[i] = view_proj * glm::vec4(quad.corners[i], 1.0f);
+
+    for (const glm::vec4& plane : view_planes) {
+        count = clip_polygon(poly, count, plane, clipped);
+        if (count < 3)
+            return;
+        std::copy(clipped, clipped + count, poly);
+    }
+
+    glm::vec2 screen[OCCLUSION_CLIP_VERTICES];
+    float inv_w[OCCLUSION_CLIP_VERTICES];
+    float top = INFINITY;
+    float bottom = -INFINITY;
+    for (int i = 0; i < count; i++) {
+        inv_w[i] = 1.0f / poly[i].w;
+        glm::vec2 ndc = glm::vec2(poly[i].x, poly[i].y) * inv_w[i];
+        screen[i] = (ndc * 0.5f + 0.5f) * glm::vec2(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+        top = std::min(top, screen[i].y);
+        bottom = std::max(bottom, screen[i].y);
+    }
+
+    // the inverse depth from the largest triangle of a fan over it, a
+    // clipped polygon can have slivers. The polygon is flat, any of them
+    // gives the same plane.
+    occlusion_polygon p;
+    float area = 0.0f;
+    for (int i = 1; i + 1 < count; i++) {
+        glm::vec3 e0 = edge_function(screen[i], screen[i + 1]);
+        glm::vec3 e1 = edge_function(screen[i + 1], screen[0]);
+        glm::vec3 e2 = edge_function(screen[0], screen[i]);
+        float a = e0.x * screen[0].x + e0.y * screen[0].y + e0.z;
+        if (std::fabs(a) > std::fabs(area)) {
+            area = a;
+            // each edge function over the area is the weight of the vertex
+            // across from it
+            p.inv_depth = (e0 * inv_w[0] + e1 * inv_w[i] + e2 * inv_w[i + 1]) / a;
+        }
+    }
+    if (std::fabs(area) < 1e-6f)
+        return;
+
+    // Occluders are seen from both sides, all edges turn the same way. Each
+    // is moved in by half a pixel's extent along its normal, so the center
+    // of a pixel is only inside when all of the pixel is.
+    float turn = area < 0.0f ? -1.0f : 1.0f;
+    p.edge_count = count;
+    for (int i = 0; i < count; i++) {
+        glm::vec3 e = turn * edge_function(screen[i], screen[(i + 1) % count]);
+        e.z -= 0.5f * (std::fabs(e.x) + std::fabs(e.y));
+        p.edges[i] = e;
+    }
+
+    // the plane at a pixel's center less half its extent is the farthest
+    // the occluder gets over that pixel
+    p.inv_depth.z -= 0.5f * (std::fabs(p.inv_depth.x) + std::fabs(p.inv_depth.y));
+
+    p.y0 = std::clamp((int) std::floor(top), 0, OCCLUSION_HEIGHT);
+    p.y1 = std::clamp((int) std::ceil(bottom), 0, OCCLUSION_HEIGHT);
+    polygons.push_back(p);
+}
+
+// Every row of a convex polygon is one span: each edge bounds the centers
+// inside from one side. The loop over the span has no branches, so it is
+// vectorized.
+void occlusion_buffer::rasterize_band(int y_begin, int y_end) {
+    for (const occlusion_polygon& p : polygons) {
+        int y0 = std::max(p.y0, y_begin);
+        int y1 = std::min(p.y1, y_end);
+
+        for (int y = y0; y < y1; y++) {
+            float py = y + 0.5f;
+            float left = 0.0f;
+            float right = OCCLUSION_WIDTH;
+
+            for (int i = 0; i < p.edge_count; i++) {
+                const glm::vec3& e = p.edges[i];
+                float c = e.y * py + e.z;
+                if (e.x > 0.0f)
+                    left = std::max(left, -c / e.x);
+                else if (e.x < 0.0f)
+                    right = std::min(right, -c / e.x);
+                else if (c < 0.0f)
+                    right = -1.0f;
+            }
+
+            // the pixels whose center is within [left, right], nearly
+            // upright edges put the bounds far off screen
+            left = std::min(left, (float) OCCLUSION_WIDTH);
+            right = std::max(right, -1.0f);
+            int x0 = (int) std::ceil(left - 0.5f);
+            int x1 = (int) std::floor(right - 0.5f) + 1;
+            float d = p.inv_depth.y * py + p.inv_depth.z;
+            float* row = &depth[(size_t) y * OCCLUSION_WIDTH];
+
+            for (int x = x0; x < x1; x++)
+                row[x] = std::max(row[x], p.inv_depth.x * (x + 0.5f) + d);
+        }
+    }
+}
+
+void occlusion_buffer::rasterize(const glm::mat4& view_proj, const std::vector<occluder_quad>& quads) {
+    TRACE_ZONE("occlusion rasterize");
+
+    this->view_proj = view_proj;
+    depth.assign((size_t) OCCLUSION_WIDTH * OCCLUSION_HEIGHT, 0.0f);
+    polygons.clear();
+    for (const occluder_quad& quad : quads)
+        setup(quad);
+
+    // each band only writes its own rows
+    const int bands = OCCLUSION_HEIGHT / OCCLUSION_BAND_ROWS;
+    job_parallel_for(bands, 1, [this](int begin, int end) {
+        rasterize_band(begin * OCCLUSION_BAND_ROWS, end * OCCLUSION_BAND_ROWS);
+    });
+}
+
+bool occlusion_buffer::visible(glm::vec3 min, glm::vec3 max, float bias) const {
+    glm::vec4 corners[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+        corners[i] = view_proj * glm::vec4(corner, 1.0f);
+    }
+
+    // out of the view when all corners are past one of its planes
+    for (const glm::vec4& plane : view_planes) {
+        int outside = 0;
+        for (const glm::vec4& corner : corners)
+            outside += glm::dot(plane, corner) < 0.0f;
+        if (outside == 8)
+            return false;
+    }
+
+    glm::vec2 lo = glm::vec2(INFINITY);
+    glm::vec2 hi = glm::vec2(-INFINITY);
+    float nearest = INFINITY;
+    for (const glm::vec4& corner : corners) {
+        if (corner.w < OCCLUSION_NEAR)
+            return true;
+
+        glm::vec2 screen = (glm::vec2(corner.x, corner.y) / corner.w * 0.5f + 0.5f) *
+                           glm::vec2(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+        lo = glm::min(lo, screen);
+        hi = glm::max(hi, screen);
+        nearest = std::min(nearest, corner.w);
+    }
+
+    float behind = nearest - bias;
+    if (behind <= 0.0f || depth.empty())
+        return true;
+    float threshold = 1.0f / behind;
+
+    // every pixel the box touches, the occluders only cover whole ones
+    int x0 = std::clamp((int) std::floor(lo.x), 0, OCCLUSION_WIDTH);
+    int y0 = std::clamp((int) std::floor(lo.y), 0, OCCLUSION_HEIGHT);
+    int x1 = std::clamp((int) std::floor(hi.x) + 1, 0, OCCLUSION_WIDTH);
+    int y1 = std::clamp((int) std::floor(hi.y) + 1, 0, OCCLUSION_HEIGHT);
+
+    for (int y = y0; y < y1; y++) {
+        const float* row = &depth[(size_t) y * OCCLUSION_WIDTH];
+        for (int x = x0; x < x1; x++) {
+            if (row[x] <= threshold)
+                return true;
+        }
+    }
+    return false;
+}
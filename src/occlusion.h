@@ -0,0 +1,71 @@
+#ifndef IT_OCCLUSION_H
+#define IT_OCCLUSION_H
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// Pixels of the occlusion buffer, whatever the viewport. Rows are a multiple
+// of 8 floats so the span of an occluder on a row is a few vector ops.
+#define OCCLUSION_WIDTH  256
+#define OCCLUSION_HEIGHT 128
+// rows of the buffer one job rasterizes.
+#define OCCLUSION_BAND_ROWS 16
+
+// boxes reaching closer to the camera than this (in view depth) are always
+// visible, they can't be projected.
+#define OCCLUSION_NEAR 0.1f
+
+// a quad clipped by the near plane and the four sides of the view, each can
+// add a vertex.
+#define OCCLUSION_CLIP_VERTICES (4 + 5)
+
+/**
+ * @brief A quad that hides what is behind it, its corners in order around
+ * it. Seen from either side.
+ */
+struct occluder_quad {
+    glm::vec3 corners[4];
+};
+
+/**
+ * @brief An occluder clipped to the view and set up for the bands: edge
+ * functions in pixels (a x + b y + c, all >= 0 where a pixel is wholly
+ * inside) and the inverse view depth as a plane over the screen, the
+ * farthest it gets within a pixel.
+ */
+struct occlusion_polygon {
+    int edge_count;
+    glm::vec3 edges[OCCLUSION_CLIP_VERTICES];
+    glm::vec3 inv_depth;
+    int y0, y1;
+};
+
+/**
+ * @brief A coarse depth buffer of a few large occluders, rasterized on the
+ * CPU (no GPU readbacks, it does the same on any driver) so whole chunks can
+ * be tested against it before they are drawn. Holds the inverse view depth
+ * of the nearest occluder per pixel, 0 where there is none; it is linear
+ * over the screen, so it doesn't depend on the far plane. Only pixels an
+ * occluder covers whole count, what shows through a gap narrower than a
+ * pixel is never hidden.
+ */
+class occlusion_buffer {
+    glm::mat4 view_proj = glm::mat4(1.0f);
+    std::vector<float> depth;
+    std::vector<occlusion_polygon> polygons;
+
+    void setup(const occluder_quad& quad);
+    void rasterize_band(int y_begin, int y_end);
+
+public:
+    // clears the buffer and rasterizes quads as seen through view_proj, the
+    // bands in parallel on the job workers.
+    void rasterize(const glm::mat4& view_proj, const std::vector<occluder_quad>& quads);
+
+    // If any of the box from min to max may be seen: it is in the view and
+    // not all behind occluders nearer than it by more than bias.
+    bool visible(glm::vec3 min, glm::vec3 max, float bias) const;
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "options.h"
+#include "net.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static void usage(const char* name) {
+    std::fprintf(
+            stderr,
+            "usage: %s [options]\n"
+            "  --size N | WxHxL   maze size in cells (default %dx%dx%d)\n"
+            "  --seed N           generation seed (default random)\n"
+            "  --load FILE        use a prebuilt binary maze file\n"
+            "  --save FILE        write the generated maze to FILE\n"
+            "  --save-no-mesh     leave the mesh out of the saved file\n"
+            "  --print            print the maze as text\n"
+            "  --stream           stream the chunks around the camera of the\n"
+            "                     loaded maze instead of keeping all of it\n"
+            "  --stream-radius N  chunks kept around the camera (default %d)\n"
+            "  --stream-budget MB resident memory budget (default %d)\n"
+            "  --present MODE     vsync, adaptive or uncapped (default vsync)\n"
+            "  --stats            print frame rate and input latency\n"
+            "  --no-idle          draw every frame, even when nothing moves\n"
+            "  --no-occlusion     draw the chunks hidden behind nearby walls\n"
+            "  --lights N         put N torches in the maze (default 0)\n"
+            "  --players N        split the screen between N local players,\n"
+            "                     up to %d, the others use game controllers\n"
+            "  --overlay          show frame and GPU pass timings (F3)\n"
+            "  --frame-budget MS  draw the scene at a lower resolution while\n"
+            "                     the GPU takes longer than MS a frame\n"
+            "  --trace FILE       record a Chrome trace, written to FILE on\n"
+            "                     exit and when F4 is pressed\n"
+            "  --headless         render offscreen without a window, then\n"
+            "                     print the frame times\n"
+            "  --frames N         frames to render headless (default %d, or\n"
+            "                     the length of the replay)\n"
+            "  --camera-path FILE follow the \"x y z fx fy fz\" keys in FILE\n"
+            "  --screenshot FILE  write the last headless frame as a ppm\n"
+            "  --json FILE        write the headless results to FILE\n"
+            "  --record FILE      write the input and maze seed to FILE\n"
+            "  --replay FILE      play back a recorded input log, in the maze\n"
+            "                     it was recorded in unless --load is given\n"
+            "  --connect HOST     join the game of an it-server, HOST:PORT for\n"
+            "                     another port than %d\n",
+            name,
+            MAZE_WIDTH,
+            MAZE_HEIGHT,
+            MAZE_LENGTH,
+            STREAM_DEFAULT_RADIUS,
+            STREAM_DEFAULT_BUDGET_MB,
+            SIM_MAX_PLAYERS,
+            HEADLESS_DEFAULT_FRAMES,
+            NET_DEFAULT_PORT);
+}
+
+bool parse_options(int argc, char** argv, options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (!std::strcmp(arg, "--size") && value) {
+            if (!parse_maze_size(value, opts.maze_size)) {
+                std::fprintf(stderr, "bad maze size: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--seed") && value) {
+            opts.seed = std::strtoul(value, nullptr, 0);
+            i++;
+        } else if (!std::strcmp(arg, "--load") && value) {
+            opts.load_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--save") && value) {
+            opts.save_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--save-no-mesh")) {
+            opts.save_mesh = false;
+        } else if (!std::strcmp(arg, "--print")) {
+            opts.print = true;
+        } else if (!std::strcmp(arg, "--stream")) {
+            opts.stream = true;
+        } else if (!std::strcmp(arg, "--stream-radius") && value) {
+            opts.stream_radius = std::atoi(value);
+            if (opts.stream_radius < 0) {
+                std::fprintf(stderr, "bad stream radius: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--stream-budget") && value) {
+            // strtoul takes a minus sign and wraps around
+            long long budget = std::strtoll(value, nullptr, 0);
+            if (budget < 0 || (unsigned long long) budget > (SIZE_MAX >> 20)) {
+                std::fprintf(stderr, "bad stream budget: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            opts.stream_budget_mb = (size_t) budget;
+            i++;
+        } else if (!std::strcmp(arg, "--present") && value) {
+            if (!parse_present_mode(value, opts.present)) {
+                std::fprintf(stderr, "bad present mode: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--stats")) {
+            opts.stats = true;
+        } else if (!std::strcmp(arg, "--no-idle")) {
+            opts.idle = false;
+        } else if (!std::strcmp(arg, "--no-occlusion")) {
+            opts.occlusion = false;
+        } else if (!std::strcmp(arg, "--lights") && value) {
+            opts.lights = std::max(0, std::atoi(value));
+            i++;
+        } else if (!std::strcmp(arg, "--players") && value) {
+            opts.players = std::atoi(value);
+            if (opts.players < 1 || opts.players > SIM_MAX_PLAYERS) {
+                std::fprintf(stderr, "bad player count: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--overlay")) {
+            opts.overlay = true;
+        } else if (!std::strcmp(arg, "--frame-budget") && value) {
+            opts.frame_budget_ms = (float) std::strtod(value, nullptr);
+            if (opts.frame_budget_ms <= 0.0f) {
+                std::fprintf(stderr, "bad frame budget: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--trace") && value) {
+            opts.trace_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--headless")) {
+            opts.headless = true;
+        } else if (!std::strcmp(arg, "--frames") && value) {
+            opts.frames = std::atoi(value);
+            if (opts.frames < 0) {
+                std::fprintf(stderr, "bad frame count: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--camera-path") && value) {
+            opts.camera_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--screenshot") && value) {
+            opts.screenshot_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--json") && value) {
+            opts.json_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--record") && value) {
+            opts.record_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--replay") && value) {
+            opts.replay_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--connect") && value) {
+            opts.connect = value;
+            i++;
+        } else if (!std::strcmp(arg, "--help")) {
+            usage(argv[0]);
+            return false;
+        } else {
+            std::fprintf(stderr, "unknown option: %s\n", arg);
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (opts.present == PRESENT_UNCAPPED)
+        opts.stats = true;
+
+    if (opts.stream && !opts.load_path) {
+        std::fprintf(stderr, "--stream needs a maze file to --load\n");
+        return false;
+    }
+
+    if (opts.stream && opts.players > 1) {
+        std::fprintf(stderr, "--stream keeps the chunks around one camera, not --players\n");
+        return false;
+    }
+
+    if ((opts.camera_path || opts.screenshot_path || opts.json_path) && !opts.headless) {
+        std::fprintf(stderr, "--camera-path, --screenshot and --json need --headless\n");
+        return false;
+    }
+
+    if (opts.record_path && (opts.replay_path || opts.headless)) {
+        std::fprintf(stderr, "--record needs live input, not --replay or --headless\n");
+        return false;
+    }
+
+    if (opts.replay_path && opts.camera_path) {
+        std::fprintf(stderr, "--replay and --camera-path both move the camera\n");
+        return false;
+    }
+
+    if (opts.connect && (opts.record_path || opts.replay_path || opts.camera_path)) {
+        std::fprintf(stderr, "--connect moves the player from the server, not --record, --replay or --camera-path\n");
+        return false;
+    }
+
+    if (opts.connect && opts.players > 1) {
+        std::fprintf(stderr, "--connect plays one player, not --players\n");
+        return false;
+    }
+
+    return true;
+}
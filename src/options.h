@@ -0,0 +1,81 @@
+#ifndef IT_OPTIONS_H
+#define IT_OPTIONS_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+#include "headless.h"
+#include "maze.h"
+#include "maze_stream.h"
+#include "present.h"
+#include "simulation.h"
+
+/**
+ * @brief Everything that can be set from the command line.
+ */
+struct options {
+    glm::ivec3 maze_size = glm::ivec3(MAZE_WIDTH, MAZE_HEIGHT, MAZE_LENGTH);
+    uint32_t seed = 0;
+
+    // binary maze file to load instead of generating one.
+    const char* load_path = nullptr;
+    // where to write the generated maze, and if the mesh goes with it.
+    const char* save_path = nullptr;
+    bool save_mesh = true;
+    // dump the maze as text to stdout once it is built.
+    bool print = false;
+
+    // keep only the chunks around the camera of the loaded maze resident.
+    bool stream = false;
+    int stream_radius = STREAM_DEFAULT_RADIUS;
+    size_t stream_budget_mb = STREAM_DEFAULT_BUDGET_MB;
+
+    present_mode present = PRESENT_VSYNC;
+    // print throughput and latency every second, always on when uncapped.
+    bool stats = false;
+    // skip drawing and sleep while the frame wouldn't change, never when
+    // uncapped.
+    bool idle = true;
+    // test chunks against the walls around the camera before drawing them.
+    bool occlusion = true;
+    // torches placed in random cells, lit with clustered shading.
+    int lights = 0;
+    // local players sharing the screen, the ones after the first play with
+    // game controllers.
+    int players = 1;
+    // frame and pass timings drawn over the frame, F3 toggles it.
+    bool overlay = false;
+    // gpu ms a frame may take before the scene is drawn smaller and
+    // upscaled, 0 always draws it at the window's resolution.
+    float frame_budget_ms = 0.0f;
+    // record trace zones, written to trace_path at exit and on F4.
+    const char* trace_path = nullptr;
+
+    // render offscreen without a window for frames frames, then exit. 0 is
+    // the whole replay, or HEADLESS_DEFAULT_FRAMES without one.
+    bool headless = false;
+    int frames = 0;
+    // camera path to follow instead of the simulation, and where to write the
+    // last frame.
+    const char* camera_path = nullptr;
+    const char* screenshot_path = nullptr;
+    // headless results as JSON, for the perf gate.
+    const char* json_path = nullptr;
+
+    // input log to write at exit, or to play back instead of live input.
+    const char* record_path = nullptr;
+    const char* replay_path = nullptr;
+
+    // host[:port] of an it-server to join, the maze is the server's.
+    const char* connect = nullptr;
+};
+
+/**
+ * @brief Parses argv into opts, prints the usage to stderr on bad input.
+ *
+ * @return false If the arguments could not be parsed.
+ */
+bool parse_options(int argc, char** argv, options& opts);
+
+#endif
@@ -0,0 +1,230 @@
+#include "overlay.h"
+#include "memory.h"
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+// 5x7 glyphs in 6x8 cells, printable ascii from 32 on, 16 to a row.
+#define GLYPH_WIDTH   5
+#define GLYPH_HEIGHT  7
+#define GLYPH_CELL_W  6
+#define GLYPH_CELL_H  8
+#define ATLAS_COLUMNS 16
+#define ATLAS_ROWS    6
+#define ATLAS_WIDTH   (ATLAS_COLUMNS * GLYPH_CELL_W)
+#define ATLAS_HEIGHT  (ATLAS_ROWS * GLYPH_CELL_H)
+
+// glyph 127 (del) is a solid block, used for the background.
+#define GLYPH_SOLID   127
+
+// pixels per atlas texel on screen
+#define OVERLAY_SCALE 2.0f
+
+struct glyph_bits {
+    char c;
+    // one row per byte, bit 4 is the leftmost column.
+    uint8_t rows[GLYPH_HEIGHT];
+};
+
+// only what the overlay prints, lower case is drawn as upper case.
+static const glyph_bits glyphs[] = {
+    { '0', { 0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E } },
+    { '1', { 0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+    { '2', { 0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F } },
+    { '3', { 0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E } },
+    { '4', { 0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02 } },
+    { '5', { 0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E } },
+    { '6', { 0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E } },
+    { '7', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 } },
+    { '8', { 0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E } },
+    { '9', { 0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C } },
+    { 'A', { 0x0E, 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11 } },
+    { 'B', { 0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E } },
+    { 'C', { 0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E } },
+    { 'D', { 0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C } },
+    { 'E', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F } },
+    { 'F', { 0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10 } },
+    { 'G', { 0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F } },
+    { 'H', { 0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11 } },
+    { 'I', { 0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E } },
+    { 'J', { 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C } },
+    { 'K', { 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 } },
+    { 'L', { 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F } },
+    { 'M', { 0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11 } },
+    { 'N', { 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 } },
+    { 'O', { 0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+    { 'P', { 0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10 } },
+    { 'Q', { 0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D } },
+    { 'R', { 0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11 } },
+    { 'S', { 0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E } },
+    { 'T', { 0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 } },
+    { 'U', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E } },
+    { 'V', { 0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04 } },
+    { 'W', { 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A } },
+    { 'X', { 0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11 } },
+    { 'Y', { 0x11, 0x11, 0x11, 0x0A, 0x04, 0x04, 0x04 } },
+    { 'Z', { 0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F } },
+    { '.', { 0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C } },
+    { ':', { 0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00 } },
+    { '-', { 0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00 } },
+    { '/', { 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 } },
+    { '%', { 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 } },
+};
+
+static glm::ivec2 glyph_cell(int c) {
+    int i = c - 32;
+    return glm::ivec2((i % ATLAS_COLUMNS) * GLYPH_CELL_W, (i / ATLAS_COLUMNS) * GLYPH_CELL_H);
+}
+
+bool perf_overlay::init(GLuint program) {
+    uint8_t pixels[ATLAS_HEIGHT][ATLAS_WIDTH] = {};
+
+    for (const glyph_bits& g : glyphs) {
+        glm::ivec2 cell = glyph_cell(g.c);
+        for (int y = 0; y < GLYPH_HEIGHT; y++) {
+            for (int x = 0; x < GLYPH_WIDTH; x++) {
+                if (g.rows[y] & (0x10 >> x))
+                    pixels[cell.y + y][cell.x + x] = 255;
+            }
+        }
+    }
+
+    glm::ivec2 solid = glyph_cell(GLYPH_SOLID);
+    for (int y = 0; y < GLYPH_CELL_H; y++) {
+        for (int x = 0; x < GLYPH_CELL_W; x++)
+            pixels[solid.y + y][solid.x + x] = 255;
+    }
+
+    glGenTextures(1, &atlas);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, ATLAS_WIDTH, ATLAS_HEIGHT, 0,
+                 GL_RED, GL_UNSIGNED_BYTE, pixels);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    memory_add(MEMORY_GPU_TEXTURES, ATLAS_WIDTH * ATLAS_HEIGHT);
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &vbo);
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    const GLuint pos_attrib_index = 0;
+    const GLuint uv_attrib_index = 1;
+    const GLuint color_attrib_index = 2;
+
+    glVertexAttribPointer(pos_attrib_index, 2, GL_FLOAT, GL_FALSE, sizeof(overlay_vertex),
+                          (void*) offsetof(overlay_vertex, pos));
+    glVertexAttribPointer(uv_attrib_index, 2, GL_FLOAT, GL_FALSE, sizeof(overlay_vertex),
+                          (void*) offsetof(overlay_vertex, uv));
+    glVertexAttribPointer(color_attrib_index, 4, GL_FLOAT, GL_FALSE, sizeof(overlay_vertex),
+                          (void*) offsetof(overlay_vertex, color));
+    glEnableVertexAttribArray(pos_attrib_index);
+    glEnableVertexAttribArray(uv_attrib_index);
+    glEnableVertexAttribArray(color_attrib_index);
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "atlas"), 0);
+    screen_size_loc = glGetUniformLocation(program, "screen_size");
+
+    return true;
+}
+
+void perf_overlay::append_quad(glm::vec2 pos, glm::vec2 size, int glyph, glm::vec4 color) {
+    glm::vec2 texel = glm::vec2(1.0f / ATLAS_WIDTH, 1.0f / ATLAS_HEIGHT);
+    glm::vec2 uv0 = glm::vec2(glyph_cell(glyph)) * texel;
+    glm::vec2 uv1 = uv0 + glm::vec2(GLYPH_CELL_W, GLYPH_CELL_H) * texel;
+
+    // solid cells are sampled in the middle so their edges don't bleed
+    if (glyph == GLYPH_SOLID)
+        uv1 = uv0 = (uv0 + uv1) * 0.5f;
+
+    overlay_vertex a = { pos, uv0, color };
+    overlay_vertex b = { pos + glm::vec2(size.x, 0.0f), glm::vec2(uv1.x, uv0.y), color };
+    overlay_vertex c = { pos + size, uv1, color };
+    overlay_vertex d = { pos + glm::vec2(0.0f, size.y), glm::vec2(uv0.x, uv1.y), color };
+
+    vertices.insert(vertices.end(), { a, b, c, a, c, d });
+}
+
+void perf_overlay::append_text(glm::vec2 pos, const char* text, glm::vec4 color) {
+    glm::vec2 size = glm::vec2(GLYPH_CELL_W, GLYPH_CELL_H) * OVERLAY_SCALE;
+
+    for (const char* p = text; *p; p++, pos.x += size.x) {
+        int c = std::toupper((unsigned char) *p);
+        if (c > ' ' && c < GLYPH_SOLID)
+            append_quad(pos, size, c, color);
+    }
+}
+
+void perf_overlay::draw(GLuint program, const frame_profile& profile, int width, int height) {
+    const glm::vec4 background = glm::vec4(0.0f, 0.0f, 0.0f, 0.6f);
+    const glm::vec4 header = glm::vec4(0.6f, 0.8f, 1.0f, 1.0f);
+    const glm::vec4 text = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+
+    const float line = GLYPH_CELL_H * OVERLAY_SCALE;
+    const int columns = 32;
+    const glm::vec2 origin = glm::vec2(8.0f);
+
+    // the timings, then what every memory_use holds
+    const int lines = TIMING_COUNT + 1 + MEMORY_COUNT + 1;
+
+    vertices.clear();
+    append_quad(origin - 4.0f,
+                glm::vec2(columns * GLYPH_CELL_W * OVERLAY_SCALE, lines * line) + 8.0f,
+                GLYPH_SOLID,
+                background);
+
+    char buffer[64];
+    glm::vec2 pos = origin;
+    std::snprintf(buffer, sizeof(buffer), "%-15s %7s %7s", "ms", "p50", "p99");
+    append_text(pos, buffer, header);
+
+    for (int t = 0; t < TIMING_COUNT; t++) {
+        pos.y += line;
+
+        profile_timing timing = (profile_timing) t;
+        std::snprintf(buffer, sizeof(buffer), "%-15s %7.2f %7.2f",
+                      frame_profile::name(timing),
+                      profile.percentile(timing, 0.5f),
+                      profile.percentile(timing, 0.99f));
+        append_text(pos, buffer, text);
+    }
+
+    pos.y += line;
+    std::snprintf(buffer, sizeof(buffer), "%-15s %7s", "memory", "MB");
+    append_text(pos, buffer, header);
+
+    for (int u = 0; u < MEMORY_COUNT; u++) {
+        pos.y += line;
+
+        memory_use use = (memory_use) u;
+        std::snprintf(buffer, sizeof(buffer), "%-15s %7.2f", memory_name(use), memory_bytes(use) / (1024.0 * 1024.0));
+        append_text(pos, buffer, text);
+    }
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+
+    // orphan the buffer every frame, the text changes every frame anyway
+    if (vertices.size() > vbo_vertices) {
+        memory_add(MEMORY_GPU_BUFFERS, (vertices.size() - vbo_vertices) * sizeof(overlay_vertex));
+        vbo_vertices = vertices.size();
+    }
+    glBufferData(GL_ARRAY_BUFFER, vbo_vertices * sizeof(overlay_vertex), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(overlay_vertex), vertices.data());
+
+    glUseProgram(program);
+    glUniform2f(screen_size_loc, (float) width, (float) height);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, (GLsizei) vertices.size());
+    glEnable(GL_DEPTH_TEST);
+}
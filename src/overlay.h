@@ -0,0 +1,40 @@
+#ifndef IT_OVERLAY_H
+#define IT_OVERLAY_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "profiler.h"
+
+/**
+ * @brief Text drawn over the frame with the p50/p99 of every timing in a
+ * frame_profile and the bytes of every memory_use. The glyphs come from a
+ * small built in atlas and the whole overlay is a single draw.
+ */
+class perf_overlay {
+    struct overlay_vertex {
+        glm::vec2 pos;
+        glm::vec2 uv;
+        glm::vec4 color;
+    };
+
+    GLuint atlas = 0;
+    GLuint vao = 0;
+    GLuint vbo = 0;
+    size_t vbo_vertices = 0;
+
+    GLint screen_size_loc;
+
+    std::vector<overlay_vertex> vertices;
+
+    void append_quad(glm::vec2 pos, glm::vec2 size, int glyph, glm::vec4 color);
+    void append_text(glm::vec2 pos, const char* text, glm::vec4 color);
+
+public:
+    bool init(GLuint program);
+    void draw(GLuint program, const frame_profile& profile, int width, int height);
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "present.h"
+
+#include <SDL2/SDL.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+bool parse_present_mode(const char* name, present_mode& mode) {
+    if (!std::strcmp(name, "vsync"))
+        mode = PRESENT_VSYNC;
+    else if (!std::strcmp(name, "adaptive"))
+        mode = PRESENT_ADAPTIVE;
+    else if (!std::strcmp(name, "uncapped"))
+        mode = PRESENT_UNCAPPED;
+    else
+        return false;
+
+    return true;
+}
+
+void set_present_mode(present_mode mode) {
+    switch (mode) {
+    case PRESENT_VSYNC:
+        SDL_GL_SetSwapInterval(1);
+        break;
+    case PRESENT_ADAPTIVE:
+        if (SDL_GL_SetSwapInterval(-1) < 0) {
+            std::fprintf(stderr, "adaptive vsync not supported, using vsync\n");
+            SDL_GL_SetSwapInterval(1);
+        }
+        break;
+    case PRESENT_UNCAPPED:
+        SDL_GL_SetSwapInterval(0);
+        break;
+    }
+}
+
+present_stats::~present_stats() {
+    for (GLsync fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+}
+
+void present_stats::poll(int64_t now) {
+    for (int i = 0; i < PRESENT_FENCES; i++) {
+        if (!fences[i])
+            continue;
+
+        if (glClientWaitSync(fences[i], 0, 0) == GL_TIMEOUT_EXPIRED)
+            continue;
+
+        double latency = (now - input_times[i]) * 1e-6;
+        latency_sum += latency;
+        latency_max = std::max(latency_max, latency);
+        latencies++;
+
+        glDeleteSync(fences[i]);
+        fences[i] = nullptr;
+    }
+}
+
+void present_stats::presented(int64_t input_time, int64_t now) {
+    poll(now);
+
+    // a fence still pending in this slot is old enough to be dropped
+    if (fences[next])
+        glDeleteSync(fences[next]);
+
+    fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    input_times[next] = input_time;
+    next = (next + 1) % PRESENT_FENCES;
+
+    frames++;
+}
+
+void present_stats::report(int64_t now) {
+    if (!window_start)
+        window_start = now;
+
+    double seconds = (now - window_start) * 1e-9;
+    if (seconds < 1.0)
+        return;
+
+    std::printf(
+            "%.1f fps, %.3f ms/frame, motion to photon %.2f ms avg %.2f ms max\n",
+            frames / seconds,
+            1000.0 * seconds / std::max(frames, 1),
+            latencies ? latency_sum / latencies : 0.0,
+            latency_max);
+
+    window_start = now;
+    frames = 0;
+    latencies = 0;
+    latency_sum = 0.0;
+    latency_max = 0.0;
+}
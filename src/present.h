@@ -0,0 +1,49 @@
+#ifndef IT_PRESENT_H
+#define IT_PRESENT_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+enum present_mode { PRESENT_VSYNC, PRESENT_ADAPTIVE, PRESENT_UNCAPPED };
+
+bool parse_present_mode(const char* name, present_mode& mode);
+
+/**
+ * @brief Sets the swap interval of the current context. Adaptive vsync falls
+ * back to plain vsync where the driver doesn't have it.
+ */
+void set_present_mode(present_mode mode);
+
+#define PRESENT_FENCES 8
+
+/**
+ * @brief Measures throughput and motion to photon latency: the time from
+ * sampling the input a frame was built from to the GPU finishing that
+ * frame. Fences are only polled, never waited on, so the latency is an upper
+ * bound off by at most one frame.
+ */
+class present_stats {
+    GLsync fences[PRESENT_FENCES] = {};
+    int64_t input_times[PRESENT_FENCES] = {};
+    int next = 0;
+
+    int64_t window_start = 0;
+    int frames = 0;
+    int latencies = 0;
+    double latency_sum = 0.0;
+    double latency_max = 0.0;
+
+    void poll(int64_t now);
+
+public:
+    ~present_stats();
+
+    // right after the swap of a frame whose input was sampled at input_time.
+    void presented(int64_t input_time, int64_t now);
+
+    // prints the numbers of the last second, then starts over.
+    void report(int64_t now);
+};
+
+#endif
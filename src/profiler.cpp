@@ -0,0 +1,91 @@
+#include "profiler.h"
+
+#include <algorithm>
+
+void frame_profile::add(profile_timing timing, float ms) {
+    samples[timing][next[timing]] = ms;
+    next[timing] = (next[timing] + 1) % PROFILE_SAMPLES;
+    counts[timing] = std::min(counts[timing] + 1, PROFILE_SAMPLES);
+}
+
+float frame_profile::percentile(profile_timing timing, float p) const {
+    int n = counts[timing];
+    if (!n)
+        return 0.0f;
+
+    float sorted[PROFILE_SAMPLES];
+    std::copy(samples[timing], samples[timing] + n, sorted);
+
+    int k = std::min((int) (p * n), n - 1);
+    std::nth_element(sorted, sorted + k, sorted + n);
+    return sorted[k];
+}
+
+const char* frame_profile::name(profile_timing timing) {
+    switch (timing) {
+    case TIMING_FRAME:         return "frame";
+    case TIMING_SIM:           return "sim";
+    case TIMING_SWAP:          return "swap";
+    case TIMING_GPU_MAZE:      return "gpu maze";
+    case TIMING_GPU_MINIMAP:   return "gpu minimap";
+    case TIMING_GPU_UPSCALE:   return "gpu upscale";
+    case TIMING_GPU_COMPOSITE: return "gpu composite";
+    case TIMING_GPU_ARROW:     return "gpu arrow";
+    default:                   return "what??";
+    }
+}
+
+void gpu_timer::init() {
+    glGenQueries(GPU_TIMER_FRAMES * GPU_PASS_COUNT * 2, &queries[0][0][0]);
+}
+
+bool gpu_timer::read(int frame, frame_profile& profile) {
+    // the end of the last timed pass is the last query to finish
+    GLuint last = 0;
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        if (timed[frame][pass])
+            last = queries[frame][pass][1];
+    }
+
+    GLint available = 0;
+    if (last)
+        glGetQueryObjectiv(last, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return false;
+
+    frame_ms = 0.0f;
+    for (int pass = 0; pass < GPU_PASS_COUNT; pass++) {
+        if (!timed[frame][pass])
+            continue;
+
+        GLuint64 start, end;
+        glGetQueryObjectui64v(queries[frame][pass][0], GL_QUERY_RESULT, &start);
+        glGetQueryObjectui64v(queries[frame][pass][1], GL_QUERY_RESULT, &end);
+        profile.add((profile_timing) (TIMING_GPU_FIRST + pass), (end - start) * 1e-6f);
+        frame_ms += (end - start) * 1e-6f;
+    }
+    return true;
+}
+
+bool gpu_timer::begin_frame(frame_profile& profile) {
+    bool was_read = in_flight[current] && read(current, profile);
+
+    in_flight[current] = false;
+    for (bool& t : timed[current])
+        t = false;
+    return was_read;
+}
+
+void gpu_timer::begin(gpu_pass pass) {
+    glQueryCounter(queries[current][pass][0], GL_TIMESTAMP);
+}
+
+void gpu_timer::end(gpu_pass pass) {
+    glQueryCounter(queries[current][pass][1], GL_TIMESTAMP);
+    timed[current][pass] = true;
+}
+
+void gpu_timer::end_frame() {
+    in_flight[current] = true;
+    current = (current + 1) % GPU_TIMER_FRAMES;
+}
@@ -0,0 +1,85 @@
+#ifndef IT_PROFILER_H
+#define IT_PROFILER_H
+
+#include <GL/glew.h>
+
+#include <cstdint>
+
+enum gpu_pass {
+    GPU_PASS_MAZE,
+    GPU_PASS_MINIMAP,
+    GPU_PASS_UPSCALE,
+    GPU_PASS_COMPOSITE,
+    GPU_PASS_ARROW,
+    GPU_PASS_COUNT
+};
+
+enum profile_timing {
+    // cpu
+    TIMING_FRAME,
+    TIMING_SIM,
+    TIMING_SWAP,
+    // gpu, in gpu_pass order
+    TIMING_GPU_MAZE,
+    TIMING_GPU_MINIMAP,
+    TIMING_GPU_UPSCALE,
+    TIMING_GPU_COMPOSITE,
+    TIMING_GPU_ARROW,
+    TIMING_COUNT
+};
+
+#define TIMING_GPU_FIRST TIMING_GPU_MAZE
+
+// samples the percentiles are taken over, about four seconds at 60 fps.
+#define PROFILE_SAMPLES 256
+
+/**
+ * @brief Rolling window of the last PROFILE_SAMPLES times (in ms) of every
+ * timing.
+ */
+class frame_profile {
+    float samples[TIMING_COUNT][PROFILE_SAMPLES] = {};
+    int counts[TIMING_COUNT] = {};
+    int next[TIMING_COUNT] = {};
+
+public:
+    void add(profile_timing timing, float ms);
+
+    // p in [0, 1], 0 when there are no samples yet.
+    float percentile(profile_timing timing, float p) const;
+    int count(profile_timing timing) const { return counts[timing]; }
+
+    static const char* name(profile_timing timing);
+};
+
+// frames of queries in flight. Results are read this many frames later, by
+// then the GPU is done with them and reading never waits.
+#define GPU_TIMER_FRAMES 4
+
+/**
+ * @brief Times the passes of a frame on the GPU with timestamp queries kept
+ * in a ring of GPU_TIMER_FRAMES frames.
+ */
+class gpu_timer {
+    GLuint queries[GPU_TIMER_FRAMES][GPU_PASS_COUNT][2] = {};
+    bool timed[GPU_TIMER_FRAMES][GPU_PASS_COUNT] = {};
+    bool in_flight[GPU_TIMER_FRAMES] = {};
+    int current = 0;
+
+    bool read(int frame, frame_profile& profile);
+
+public:
+    // sum of the passes of the last frame read.
+    float frame_ms = 0.0f;
+
+    void init();
+
+    // reads the frame that used this slot before into profile, if the GPU
+    // is done with it, otherwise it is dropped. Returns if it was read.
+    bool begin_frame(frame_profile& profile);
+    void begin(gpu_pass pass);
+    void end(gpu_pass pass);
+    void end_frame();
+};
+
+#endif
@@ -0,0 +1,623 @@
+#include "renderer.h"
+#include "memory.h"
+#include "trace.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <glm/gtx/rotate_vector.hpp>
+
+#include <cmath>
+#include <cstdio>
+
+// what shows where no wall is drawn.
+static const glm::vec4 clear_color(1.0f, 0.3f, 0.3f, 1.0f);
+
+// quad data
+//static float quad_pos[] = {
+//     1.0f,  1.0f, 0.0f,
+//    -1.0f,  1.0f, 0.0f,
+//     1.0f, -1.0f, 0.0f,
+//
+//    -1.0f, -1.0f, 0.0f,
+//     1.0f, -1.0f, 0.0f,
+//    -1.0f,  1.0f, 0.0f,
+//};
+static float quad_pos[] = {
+     0.4,  0.4, 0.0f,
+    -0.4,  0.4, 0.0f,
+     0.4, -0.4, 0.0f,
+
+    -0.4, -0.4, 0.0f,
+     0.4, -0.4, 0.0f,
+    -0.4,  0.4, 0.0f,
+};
+
+static float quad_uv[] = {
+    1.0f, 1.0f,
+    0.0f, 1.0f,
+    1.0f, 0.0f,
+
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+    0.0f, 1.0f,
+};
+
+static float arrow_pos[] = {
+    0.0f,  0.0f, 0.0f,
+    1.0f,  0.0f, 0.0f,
+    0.8f,  0.2f, 0.0f,
+    1.0f,  0.0f, 0.0f,
+    0.8f, -0.2f, 0.0f,
+};
+
+static float arrow_color[] = {
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+    1.0f, 1.0f, 1.0f,
+};
+
+static void opengl_message_callback(
+        GLenum source,
+        GLenum type,
+        GLuint id,
+        GLenum severity,
+        GLsizei length,
+        GLchar const* message,
+        void const* user_param);
+
+void init_gl_state() {
+    glEnable(GL_DEPTH_TEST);
+
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    glEnable(GL_DEBUG_OUTPUT);
+    glDebugMessageCallback(opengl_message_callback, nullptr);
+    glViewport(0, 0, WIDTH, HEIGHT);
+
+    glLineWidth(2.0f);
+}
+
+// the quad covers 0.4 of the screen each way, one texel per pixel of it.
+renderer::renderer() : minimap(WIDTH * 2 / 5, HEIGHT * 2 / 5) {}
+
+/**
+ * @brief Distance at which CAMERA_LIGHT drops under threshold. Searched
+ * rather than solved, so the falloff can be any that only goes down.
+ */
+static float camera_light_cutoff(float threshold) {
+    double lo = 0.0;
+    double hi = 1.0;
+    while (CAMERA_LIGHT(hi * hi) >= threshold && hi < 1e6)
+        hi *= 2.0;
+
+    for (int i = 0; i < 32; i++) {
+        double mid = 0.5 * (lo + hi);
+        if (CAMERA_LIGHT(mid * mid) >= threshold)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return (float) hi;
+}
+
+bool renderer::init() {
+    if (!compile_shaders_and_link_programs(program_ids)) {
+        return false;
+    }
+
+    if (!minimap.create())
+        return false;
+
+    if (!overlay.init(program_ids[PROGRAM_OVERLAY]))
+        return false;
+
+    if (!materials.create())
+        return false;
+
+    timer.init();
+    lights.init();
+    light_cutoff = camera_light_cutoff(FAR_CULL_LIGHT);
+
+    // quad things for minimap
+    {
+        GLuint quad_pos_attrib_index = 0;
+        GLuint quad_uv_attrib_index = 1;
+
+        glGenBuffers(1, &quad_pos_vbo);
+        glGenBuffers(1, &quad_uv_vbo);
+        glGenVertexArrays(1, &quad_vao);
+    
+        glBindVertexArray(quad_vao);    
+    
+        // pos bufffer
+        glBindBuffer(GL_ARRAY_BUFFER, quad_pos_vbo);
+        glBufferData(GL_ARRAY_BUFFER,
+                     sizeof(quad_pos),
+                     quad_pos,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(quad_pos_attrib_index, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(quad_pos_attrib_index);
+
+        // uv buffer
+        glBindBuffer(GL_ARRAY_BUFFER, quad_uv_vbo);
+        glBufferData(GL_ARRAY_BUFFER,
+                     sizeof(quad_uv),
+                     quad_uv,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(quad_uv_attrib_index, 2, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(quad_uv_attrib_index);
+    }
+    
+    // arrow vao
+    {
+    
+        GLuint arrow_pos_attrib_index = 0;
+        GLuint arrow_color_attrib_index = 1;
+
+
+        glGenBuffers(1, &arrow_pos_vbo);
+        glGenBuffers(1, &arrow_color_vbo);
+        glGenVertexArrays(1, &arrow_vao);
+    
+        glBindVertexArray(arrow_vao);   
+    
+        // pos bufffer
+        glBindBuffer(GL_ARRAY_BUFFER, arrow_pos_vbo);
+        glBufferData(GL_ARRAY_BUFFER,
+                     sizeof(arrow_pos),
+                     arrow_pos,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(arrow_pos_attrib_index, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(arrow_pos_attrib_index);
+
+        // uv buffer
+        glBindBuffer(GL_ARRAY_BUFFER, arrow_color_vbo);
+        glBufferData(GL_ARRAY_BUFFER,
+                     sizeof(arrow_color),
+                     arrow_color,
+                     GL_STATIC_DRAW);
+        glVertexAttribPointer(
+                arrow_color_attrib_index,
+                3,
+                GL_FLOAT,
+                GL_FALSE,
+                6 * sizeof(float),
+                (void*)(3 * sizeof(float)));
+        
+        glVertexAttribPointer(arrow_color_attrib_index, 3, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray(arrow_color_attrib_index);
+    }
+
+    memory_add(MEMORY_GPU_BUFFERS, sizeof(quad_pos) + sizeof(quad_uv) + sizeof(arrow_pos) + sizeof(arrow_color));
+
+    // the arrow has no ao or material, it reads these instead
+    const GLuint maze_ao_attrib_index = 2;
+    const GLuint maze_material_attrib_index = 4;
+    glVertexAttrib2f(maze_ao_attrib_index, 1.0f, 1.0f);
+    glVertexAttribI1ui(maze_material_attrib_index, SHADER_MATERIALS);
+
+    viewport_index = GLEW_ARB_shader_viewport_layer_array || GLEW_AMD_vertex_shader_viewport_index;
+
+    glm::vec3 model_pos = glm::vec3(0.0f);
+    model = glm::translate(glm::mat4(1.0f), model_pos);
+
+    glUseProgram(program_ids[PROGRAM_MINIMAP]);
+    glUniform1i(glGetUniformLocation(program_ids[PROGRAM_MINIMAP], "color_texture"), 0);
+    glUniform1i(glGetUniformLocation(program_ids[PROGRAM_MINIMAP], "depth_texture"), 1);
+    glUseProgram(program_ids[PROGRAM_UPSCALE]);
+    glUniform1i(glGetUniformLocation(program_ids[PROGRAM_UPSCALE], "scene"), 0);
+    upscale_source_loc = glGetUniformLocation(program_ids[PROGRAM_UPSCALE], "source");
+    const program_names maze_programs[] = { PROGRAM_BASIC, PROGRAM_LIT, PROGRAM_VIEWS, PROGRAM_LIT_VIEWS };
+    for (program_names program : maze_programs) {
+        GLuint id = program_ids[program];
+        glUseProgram(id);
+        uniforms[program].mvp = glGetUniformLocation(id, "mvp");
+        uniforms[program].cam_pos = glGetUniformLocation(id, "cam_pos");
+        uniforms[program].grid_origin = glGetUniformLocation(id, "grid_origin");
+        uniforms[program].wall_size = glGetUniformLocation(id, "wall_size");
+        glUniform1i(glGetUniformLocation(id, "grid_size"), LIGHT_GRID_SIZE);
+        glUniform1i(glGetUniformLocation(id, "materials"), MATERIAL_TEXTURE_UNIT);
+    }
+    mvp_uniform_loc = uniforms[PROGRAM_BASIC].mvp;
+
+    return true;
+}
+
+// count views for the views programs, the others take one
+void renderer::set_view_uniforms(program_names program, int count, const glm::mat4* mvps, const glm::vec3* cam_positions) {
+    // send mvp
+    glUniformMatrix4fv(
+            uniforms[program].mvp,
+            count,
+            GL_FALSE,
+            glm::value_ptr(mvps[0]));
+
+    // send cam_pos
+    glUniform3fv(
+            uniforms[program].cam_pos,
+            count,
+            glm::value_ptr(cam_positions[0]));
+}
+
+/**
+ * @brief Culls view past light_cutoff but for the lights that reach past it
+ * inside the light grid, outside of it walls only get the camera light.
+ * Returns how far the view has to see, its far plane.
+ */
+float renderer::set_far_lights(const maze& m, maze_view& view) {
+    view.cull_distance = light_cutoff;
+    view.far_lights.clear();
+    if (point_lights.empty())
+        return light_cutoff;
+
+    float wall_size = m.get_wall_size();
+    glm::vec3 grid_min = (glm::vec3(lights.get_origin()) - 0.5f) * wall_size;
+    glm::vec3 grid_max = grid_min + (float) LIGHT_GRID_SIZE * wall_size;
+
+    float far_plane = light_cutoff;
+    for (const point_light& light : point_lights) {
+        float reach = glm::length(light.pos - view.eye) + light.radius;
+        if (reach <= light_cutoff ||
+            glm::length(glm::clamp(light.pos, grid_min, grid_max) - light.pos) > light.radius) {
+            continue;
+        }
+
+        view.far_lights.push_back(glm::vec4(light.pos, light.radius));
+        far_plane = glm::max(far_plane, reach);
+    }
+    return far_plane;
+}
+
+glm::ivec4 split_screen_viewport(int i, int count) {
+    if (count <= 1)
+        return glm::ivec4(0, 0, WIDTH, HEIGHT);
+
+    if (count == 2)
+        return glm::ivec4(i * (WIDTH / 2), 0, WIDTH / 2, HEIGHT);
+
+    // the first row on top, gl counts from the bottom
+    return glm::ivec4((i % 2) * (WIDTH / 2), (1 - i / 2) * (HEIGHT / 2), WIDTH / 2, HEIGHT / 2);
+}
+
+bool renderer::create_scene_target() {
+    glGenFramebuffers(1, &scene_fb);
+    glBindFramebuffer(GL_FRAMEBUFFER, scene_fb);
+
+    glGenTextures(1, &scene_color);
+    glBindTexture(GL_TEXTURE_2D, scene_color);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WIDTH, HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, scene_color, 0);
+
+    // never sampled, only the color is upscaled
+    glGenRenderbuffers(1, &scene_depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, scene_depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, WIDTH, HEIGHT);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, scene_depth);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (!complete) {
+        std::fprintf(stderr, "ERROR: Renderer: the scaled scene framebuffer is not complete\n");
+        return false;
+    }
+
+    // depth24 is padded to 4 bytes a texel too
+    memory_add(MEMORY_GPU_TEXTURES, (int64_t) WIDTH * HEIGHT * 8);
+    return true;
+}
+
+void renderer::update_resolution_scale() {
+    // the frame just read was drawn at the scale of its slot, its time goes
+    // with that one and not with the current
+    float scale = frame_scales[frame_slot];
+    float ms = timer.frame_ms;
+    if (scale <= 0.0f || ms <= 0.0f)
+        return;
+    if (ms <= frame_budget_ms && ms >= frame_budget_ms * RESOLUTION_HEADROOM)
+        return;
+
+    // the maze is most of the frame and its cost goes with the pixels, the
+    // square of the scale. Aims at the middle of the band that is left be.
+    float target_ms = frame_budget_ms * (1.0f + RESOLUTION_HEADROOM) * 0.5f;
+    float wanted = scale * std::sqrt(target_ms / ms);
+    resolution_scale += (wanted - resolution_scale) * RESOLUTION_SMOOTHING;
+    resolution_scale = glm::clamp(resolution_scale, RESOLUTION_MIN_SCALE, 1.0f);
+}
+
+void renderer::draw(const maze& m, const view_camera* cameras, int count) {
+    TRACE_ZONE("draw");
+    bool timed = timer.begin_frame(profile);
+
+    count = glm::clamp(count, 1, MAZE_MAX_VIEWS);
+    views.views.resize(count);
+
+    if (frame_budget_ms > 0.0f && !scene_fb && !create_scene_target())
+        frame_budget_ms = 0.0f;
+
+    if (frame_budget_ms > 0.0f && timed)
+        update_resolution_scale();
+    if (frame_budget_ms <= 0.0f)
+        resolution_scale = 1.0f;
+
+    // at the full scale the scene goes straight into the target, the upscale
+    // isn't free. The minimap, arrow and overlay always do, and after the
+    // upscale nothing reads the target's depth.
+    bool scaled = resolution_scale < 1.0f;
+    glBindFramebuffer(GL_FRAMEBUFFER, scaled ? scene_fb : target_fb);
+    glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    // the lights of the cells around the first camera, the grid follows one
+    bool lit = !point_lights.empty();
+    if (lit)
+        lights.update(m, cameras[0].pos, point_lights);
+
+    glm::ivec4 viewports[MAZE_MAX_VIEWS];
+    glm::ivec4 scene_viewports[MAZE_MAX_VIEWS];
+    glm::mat4 projs[MAZE_MAX_VIEWS];
+    glm::mat4 mvps[MAZE_MAX_VIEWS];
+    glm::vec3 cam_positions[MAZE_MAX_VIEWS];
+    for (int i = 0; i < count; i++) {
+        viewports[i] = split_screen_viewport(i, count);
+        scene_viewports[i] = glm::ivec4(glm::round(glm::vec4(viewports[i]) * resolution_scale));
+
+        // the lods are picked for the pixels that are drawn, nothing is
+        // drawn where the light is too dim to show
+        views.views[i].set_camera(cameras[i].pos, glm::radians(90.0f), scene_viewports[i].w);
+        float far_plane = set_far_lights(m, views.views[i]);
+
+        projs[i] = glm::perspective(
+                glm::radians(90.0f),
+                (float) viewports[i].z / viewports[i].w,
+                0.1f,
+                far_plane);
+
+        glm::mat4 view = glm::lookAt(
+                cameras[i].pos,
+                cameras[i].front + cameras[i].pos,
+                cameras[i].up);
+        mvps[i] = projs[i] * view * model;
+        cam_positions[i] = cameras[i].pos;
+
+        views.views[i].view_proj = mvps[i];
+        views.views[i].cull_occluded = occlusion_culling;
+    }
+
+    bool one_draw = count > 1 && viewport_index;
+    program_names maze_program = lit ?
+        (one_draw ? PROGRAM_LIT_VIEWS : PROGRAM_LIT) :
+        (one_draw ? PROGRAM_VIEWS : PROGRAM_BASIC);
+
+    glUseProgram(program_ids[maze_program]);
+    glUniform1f(uniforms[maze_program].wall_size, m.get_wall_size());
+
+    if (lit) {
+        lights.bind();
+
+        glm::ivec3 grid_origin = lights.get_origin();
+        glUniform3i(uniforms[maze_program].grid_origin, grid_origin.x, grid_origin.y, grid_origin.z);
+    }
+
+    // draw maze
+    timer.begin(GPU_PASS_MAZE);
+    if (one_draw) {
+        set_view_uniforms(maze_program, count, mvps, cam_positions);
+        for (int i = 0; i < count; i++) {
+            const glm::ivec4& v = scene_viewports[i];
+            glViewportIndexedf(i, v.x, v.y, v.z, v.w);
+        }
+
+        m.render_views(views);
+    } else {
+        // one viewport at a time
+        for (int i = 0; i < count; i++) {
+            const glm::ivec4& v = scene_viewports[i];
+            if (count > 1 || scaled)
+                glViewport(v.x, v.y, v.z, v.w);
+
+            set_view_uniforms(maze_program, 1, &mvps[i], &cam_positions[i]);
+            m.render(views.views[i]);
+        }
+    }
+    glViewport(0, 0, WIDTH, HEIGHT);
+    timer.end(GPU_PASS_MAZE);
+
+    // draw minimap, it doesn't follow a camera so the views share it
+    timer.begin(GPU_PASS_MINIMAP);
+    glUseProgram(program_ids[PROGRAM_BASIC]);
+    glUniform3fv(uniforms[PROGRAM_BASIC].cam_pos, 1, glm::value_ptr(cam_positions[0]));
+    glUniform1f(uniforms[PROGRAM_BASIC].wall_size, m.get_wall_size());
+    minimap.render(program_ids, mvp_uniform_loc, m);
+    timer.end(GPU_PASS_MINIMAP);
+
+    // bilinear, a view at a time so one doesn't bleed into the next. After
+    // the minimap, so the scene has been drawn by then on GPUs that only
+    // start a framebuffer when another one is bound.
+    if (scaled) {
+        timer.begin(GPU_PASS_UPSCALE);
+        glBindFramebuffer(GL_FRAMEBUFFER, target_fb);
+
+        // three views leave a quarter of the window no view is stretched
+        // over, it is cleared like the scene (the minimap clears to its own
+        // color)
+        if (count == 3) {
+            glClearColor(clear_color.x, clear_color.y, clear_color.z, clear_color.w);
+            glClear(GL_COLOR_BUFFER_BIT);
+        }
+
+        glDisable(GL_DEPTH_TEST);
+        glDisable(GL_BLEND);
+        glUseProgram(program_ids[PROGRAM_UPSCALE]);
+        glBindVertexArray(quad_vao);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, scene_color);
+        for (int i = 0; i < count; i++) {
+            glm::vec4 source = glm::vec4(scene_viewports[i]) / glm::vec4(WIDTH, HEIGHT, WIDTH, HEIGHT);
+            glUniform4fv(upscale_source_loc, 1, glm::value_ptr(source));
+            glViewport(viewports[i].x, viewports[i].y, viewports[i].z, viewports[i].w);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glEnable(GL_BLEND);
+        glEnable(GL_DEPTH_TEST);
+        timer.end(GPU_PASS_UPSCALE);
+    }
+
+    // lines aren't always cut at the edge of the viewport, the scissor keeps
+    // every view's arrow in its own view
+    if (count > 1)
+        glEnable(GL_SCISSOR_TEST);
+
+    timer.begin(GPU_PASS_COMPOSITE);
+    minimap.screen_fb = target_fb;
+    for (int i = 0; i < count; i++) {
+        glViewport(viewports[i].x, viewports[i].y, viewports[i].z, viewports[i].w);
+        glScissor(viewports[i].x, viewports[i].y, viewports[i].z, viewports[i].w);
+        minimap.composite(quad_vao, program_ids);
+    }
+    timer.end(GPU_PASS_COMPOSITE);
+
+    // draw arrow in perspective, but not in viewport.
+    timer.begin(GPU_PASS_ARROW);
+    glDisable(GL_DEPTH_TEST);
+    glBindVertexArray(arrow_vao);
+    glUseProgram(program_ids[PROGRAM_BASIC]);
+
+    for (int i = 0; i < count; i++) {
+        glViewport(viewports[i].x, viewports[i].y, viewports[i].z, viewports[i].w);
+        glScissor(viewports[i].x, viewports[i].y, viewports[i].z, viewports[i].w);
+        // views narrower than the screen shrink the arrow so it still fits
+        // in the corner
+        float aspect = (float) viewports[i].z / viewports[i].w;
+        float arrow_size = glm::min(1.0f, aspect * HEIGHT / WIDTH);
+        glm::mat4 proj = glm::scale(glm::vec3(arrow_size, arrow_size, 1.0f)) * projs[i];
+
+        glm::mat4 arrow_shift = glm::translate(glm::vec3(0.8f,-0.8f, 0.0f));
+        glm::mat4 arrow_model = glm::mat4(1.0f);
+        glm::mat4 arrow_view = glm::lookAt(
+                -5.0f * cameras[i].front,
+                glm::vec3(0.0f, 0.0f, 0.0f),
+                cameras[i].up);
+
+        glm::mat4 arrow_mvp = arrow_shift * proj * arrow_view * arrow_model;
+        glUniformMatrix4fv(
+                mvp_uniform_loc,
+                1,
+                GL_FALSE,
+                glm::value_ptr(arrow_mvp));
+        glDrawArrays(GL_LINE_STRIP, 0, 5);
+
+        arrow_model = glm::rotate(arrow_model, glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        arrow_mvp = arrow_shift * proj * arrow_view * arrow_model;
+        glUniformMatrix4fv(
+                mvp_uniform_loc,
+                1,
+                GL_FALSE,
+                glm::value_ptr(arrow_mvp));
+        glDrawArrays(GL_LINE_STRIP, 0, 5);
+
+        arrow_model = glm::rotate(arrow_model, glm::radians(90.0f), glm::vec3(0.0f,-1.0f, 0.0f));
+        arrow_mvp = arrow_shift * proj * arrow_view * arrow_model;
+        glUniformMatrix4fv(
+                mvp_uniform_loc,
+                1,
+                GL_FALSE,
+                glm::value_ptr(arrow_mvp));
+        glDrawArrays(GL_LINE_STRIP, 0, 5);
+    }
+    glViewport(0, 0, WIDTH, HEIGHT);
+    glDisable(GL_SCISSOR_TEST);
+    glEnable(GL_DEPTH_TEST);
+    timer.end(GPU_PASS_ARROW);
+
+    if (show_overlay) {
+        TRACE_ZONE("draw overlay");
+        overlay.draw(program_ids[PROGRAM_OVERLAY], profile, WIDTH, HEIGHT);
+    }
+
+    frame_scales[frame_slot] = resolution_scale;
+    frame_slot = (frame_slot + 1) % GPU_TIMER_FRAMES;
+    timer.end_frame();
+}
+
+static void opengl_message_callback(
+        GLenum source,
+        GLenum type,
+        GLuint id,
+        GLenum severity,
+        GLsizei length,
+        GLchar const* message,
+        void const* user_param)
+{
+    auto const src_str = [source]() {
+        switch (source)
+        {
+        case GL_DEBUG_SOURCE_API:
+            return "API";
+        case GL_DEBUG_SOURCE_WINDOW_SYSTEM:
+            return "WINDOW SYSTEM";
+        case GL_DEBUG_SOURCE_SHADER_COMPILER:
+            return "SHADER COMPILER";
+        case GL_DEBUG_SOURCE_THIRD_PARTY:
+            return "THIRD PARTY";
+        case GL_DEBUG_SOURCE_APPLICATION:
+            return "APPLICATION";
+        case GL_DEBUG_SOURCE_OTHER:
+            return "OTHER";
+        default:
+            return "what??";
+        }
+    }();
+
+    auto const type_str = [type]() {
+        switch (type)
+        {
+        case GL_DEBUG_TYPE_ERROR:
+            return "ERROR";
+        case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR:
+            return "DEPRECATED_BEHAVIOR";
+        case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR:
+            return "UNDEFINED_BEHAVIOR";
+        case GL_DEBUG_TYPE_PORTABILITY:
+            return "PORTABILITY";
+        case GL_DEBUG_TYPE_PERFORMANCE:
+            return "PERFORMANCE";
+        case GL_DEBUG_TYPE_MARKER:
+            return "MARKER";
+        case GL_DEBUG_TYPE_OTHER:
+            return "OTHER";
+        default:
+            return "what??";
+        }
+    }();
+
+    auto const severity_str = [severity] () {
+        switch (severity) {
+        case GL_DEBUG_SEVERITY_NOTIFICATION:
+            return "NOTIFICATION";
+        case GL_DEBUG_SEVERITY_LOW:
+            return "LOW";
+        case GL_DEBUG_SEVERITY_MEDIUM:
+            return "MEDIUM";
+        case GL_DEBUG_SEVERITY_HIGH:
+            return "HIGH";
+        default:
+            return "what??";
+        }
+    }();
+
+    std::fprintf(
+            stderr,
+            "OPENGL CALLBACK: %s, %s, %s, %d, %s\n",
+            src_str,
+            type_str,
+            severity_str,
+            id,
+            message);
+}
@@ -0,0 +1,154 @@
+#ifndef IT_RENDERER_H
+#define IT_RENDERER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "lights.h"
+#include "materials.h"
+#include "maze.h"
+#include "minimap.h"
+#include "overlay.h"
+#include "profiler.h"
+#include "shaders.h"
+
+#define WIDTH 1280
+#define HEIGHT 720
+
+// the scene of a frame over budget isn't drawn at less than this much of the
+// window on each axis.
+#define RESOLUTION_MIN_SCALE 0.5f
+// the scale goes up again once the gpu frame takes less than this much of
+// the budget, so it doesn't flip between two sizes.
+#define RESOLUTION_HEADROOM 0.85f
+// part of the way to the scale a frame's time asks for that is gone each
+// frame, the times are from GPU_TIMER_FRAMES frames before.
+#define RESOLUTION_SMOOTHING 0.25f
+
+// camera light under which a wall doesn't change its pixel by a step of an
+// 8 bit channel (it is also its alpha, so it only lets through what is
+// behind). Walls further than where it drops that low aren't drawn.
+#define FAR_CULL_LIGHT (1.0f / 255.0f)
+
+static_assert(MAZE_MAX_VIEWS == SHADER_MAX_VIEWS, "the shaders don't take every view");
+static_assert(MAZE_MATERIALS == SHADER_MATERIALS, "the shaders don't take every material");
+
+/**
+ * @brief GL state every context starts with (depth test, blending, debug
+ * output, viewport).
+ */
+void init_gl_state();
+
+/**
+ * @brief Where a view of the frame is drawn from.
+ */
+struct view_camera {
+    glm::vec3 pos;
+    glm::vec3 front;
+    glm::vec3 up;
+};
+
+/**
+ * @brief Viewport (x, y, width, height) of view i of a split screen of count
+ * views: the whole target, two side by side, or a 2x2 grid.
+ */
+glm::ivec4 split_screen_viewport(int i, int count);
+
+/**
+ * @brief Draws a frame: the maze, the minimap and the arrow. Doesn't know
+ * about windows, it draws into target_fb (0 for the window).
+ */
+class renderer {
+    GLuint program_ids[PROGRAM_COUNT];
+
+    GLuint quad_vao;
+    GLuint quad_pos_vbo;
+    GLuint quad_uv_vbo;
+
+    GLuint arrow_vao;
+    GLuint arrow_pos_vbo;
+    GLuint arrow_color_vbo;
+
+    // of PROGRAM_BASIC, the minimap and the arrow are drawn with it too.
+    GLint mvp_uniform_loc;
+    // of PROGRAM_UPSCALE, the part of the scene target a view is in.
+    GLint upscale_source_loc;
+
+    // of every program the maze can be drawn with: basic, lit when there are
+    // lights, and their views versions when all the views are one draw.
+    struct maze_uniforms {
+        GLint mvp;
+        GLint cam_pos;
+        GLint grid_origin;
+        GLint wall_size;
+    };
+    maze_uniforms uniforms[PROGRAM_COUNT];
+
+    glm::mat4 model;
+
+    Minimap minimap;
+    maze_view_set views;
+    // the vertex shader routes every view to its own viewport, so all of
+    // them are drawn at once.
+    bool viewport_index = false;
+
+    gpu_timer timer;
+    perf_overlay overlay;
+
+    light_grid lights;
+    material_array materials;
+    // where the camera light drops under FAR_CULL_LIGHT.
+    float light_cutoff = 0.0f;
+
+    // the scene of a frame with a budget, as large as the window but only
+    // the bottom left resolution_scale of it is drawn to, then upscaled.
+    GLuint scene_fb = 0;
+    GLuint scene_color = 0;
+    GLuint scene_depth = 0;
+    // the scale of the frames the timer has in flight, by timer slot.
+    float frame_scales[GPU_TIMER_FRAMES] = {};
+    int frame_slot = 0;
+
+    bool create_scene_target();
+    void update_resolution_scale();
+    void set_view_uniforms(program_names program, int count, const glm::mat4* mvps, const glm::vec3* cam_positions);
+    float set_far_lights(const maze& m, maze_view& view);
+
+public:
+    GLuint target_fb = 0;
+
+    // gpu pass times are added by draw, the cpu ones by whoever runs the
+    // frame loop.
+    frame_profile profile;
+    bool show_overlay = false;
+
+    // gpu time a frame should take in ms, the scene is drawn at a lower
+    // resolution while it takes longer. 0 always draws it at the full one.
+    float frame_budget_ms = 0.0f;
+    // of the window's width and height the scene was last drawn at.
+    float resolution_scale = 1.0f;
+
+    // chunks behind the walls around a camera aren't drawn.
+    bool occlusion_culling = true;
+
+    // torches and pickups, binned again whenever they change.
+    std::vector<point_light> point_lights;
+
+    renderer();
+
+    bool init();
+
+    // A split screen of count (up to MAZE_MAX_VIEWS) views. The maze of all
+    // of them is one draw where the driver allows it, else one per view, the
+    // minimap is drawn once and composited into each view.
+    void draw(const maze& m, const view_camera* cameras, int count);
+    void draw(const maze& m, glm::vec3 cam_pos, glm::vec3 cam_front, glm::vec3 cam_up) {
+        view_camera camera = { cam_pos, cam_front, cam_up };
+        draw(m, &camera, 1);
+    }
+
+    // maze triangles in all the views of the last frame.
+    uint64_t get_triangles() const { return views.triangles(); }
+};
+
+#endif
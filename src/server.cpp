@@ -0,0 +1,328 @@
+// it-server: runs a networked game, `it --connect` joins it. Doesn't need SDL
+// or GL. --bots joins bots that wander around over loopback, to measure the
+// traffic per client and the tick time.
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "maze.h"
+#include "net.h"
+#include "net_client.h"
+#include "net_server.h"
+
+// how often a server running until it is stopped prints its numbers.
+#define SERVER_REPORT_SECONDS 10
+
+struct server_options {
+    uint16_t port = NET_DEFAULT_PORT;
+    glm::ivec3 size = glm::ivec3(MAZE_WIDTH, MAZE_HEIGHT, MAZE_LENGTH);
+    uint32_t seed = 0;
+    const char* load_path = nullptr;
+    // 0 runs until interrupted.
+    int ticks = 0;
+    int bots = 0;
+    int loss_percent = 0;
+    const char* json_path = nullptr;
+};
+
+/**
+ * @brief A client driven by random input, it holds a direction and turns at a
+ * steady rate for a while, then picks others.
+ */
+struct bot {
+    net_client client;
+    player_state player;
+    std::mt19937 rng;
+    uint32_t held = 0;
+    glm::ivec2 turn = glm::ivec2(0);
+    int ticks_left = 0;
+
+    void tick() {
+        if (--ticks_left <= 0) {
+            // one of forward, backward, right and left, or standing
+            int motion = (int) (rng() % 5);
+            held = motion < 4 ? 1u << motion : 0u;
+            turn = glm::ivec2((int) (rng() % 7) - 3, 0);
+            ticks_left = 30 + (int) (rng() % 120);
+        }
+        client.tick(player, held, turn);
+    }
+};
+
+static std::atomic<bool> running{true};
+// a bot couldn't connect, the run measured nothing.
+static std::atomic<bool> bots_failed{false};
+
+static void on_signal(int) {
+    running = false;
+}
+
+static void run_bots(net_address server, int count, std::atomic<bool>& ready, uint64_t& corrections) {
+    std::vector<bot> bots(count);
+    for (int i = 0; i < count; i++) {
+        bots[i].rng.seed(i + 1);
+        if (!bots[i].client.connect(server)) {
+            bots_failed = true;
+            running = false;
+            return;
+        }
+    }
+    ready = true;
+
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::nanoseconds(1000000000 / SIM_TICK_RATE);
+    auto next = clock::now();
+    while (running) {
+        for (bot& b : bots)
+            b.tick();
+
+        next += period;
+        std::this_thread::sleep_until(next);
+    }
+
+    corrections = 0;
+    for (bot& b : bots)
+        corrections += b.client.corrections;
+}
+
+/**
+ * @brief Traffic and tick times of a stretch of ticks. The counters hold the
+ * server's at begin, finish turns them into how much they went up by.
+ */
+struct server_stats {
+    std::vector<double> tick_ms;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    uint64_t client_ticks = 0;
+
+    void begin(const net_server& server) {
+        tick_ms.clear();
+        bytes_sent = server.socket.bytes_sent;
+        bytes_received = server.socket.bytes_received;
+        client_ticks = server.client_ticks;
+    }
+
+    void finish(const net_server& server) {
+        bytes_sent = server.socket.bytes_sent - bytes_sent;
+        bytes_received = server.socket.bytes_received - bytes_received;
+        client_ticks = server.client_ticks - client_ticks;
+    }
+
+    double client_seconds() const { return (double) client_ticks / SIM_TICK_RATE; }
+    double down_per_client() const { return client_ticks ? bytes_sent / client_seconds() : 0.0; }
+    double up_per_client() const { return client_ticks ? bytes_received / client_seconds() : 0.0; }
+
+    double tick_percentile(double p) const {
+        if (tick_ms.empty())
+            return 0.0;
+        std::vector<double> sorted = tick_ms;
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))];
+    }
+};
+
+static void print_stats(const server_stats& stats, int players) {
+    std::printf("%d players, %zu ticks: tick p50 %.3f ms, p99 %.3f ms\n",
+                players, stats.tick_ms.size(), stats.tick_percentile(0.5), stats.tick_percentile(0.99));
+    std::printf("  per client: %.0f B/s down, %.0f B/s up (payload)\n",
+                stats.down_per_client(), stats.up_per_client());
+}
+
+static bool write_json(const char* path, const server_options& opts, const server_stats& stats, uint64_t corrections) {
+    std::FILE* f = std::fopen(path, "w");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Server: could not create %s\n", path);
+        return false;
+    }
+
+    // all lower is better, for the perf gate
+    std::fprintf(f, "{\n  \"bots\": %d,\n  \"ticks\": %zu,\n  \"loss_percent\": %d,\n  \"metrics\": {\n",
+                 opts.bots, stats.tick_ms.size(), opts.loss_percent);
+    std::fprintf(f, "    \"net.%d.down_bytes_per_client_s\": %.1f,\n", opts.bots, stats.down_per_client());
+    std::fprintf(f, "    \"net.%d.up_bytes_per_client_s\": %.1f,\n", opts.bots, stats.up_per_client());
+    std::fprintf(f, "    \"net.%d.tick_p50_ms\": %.6f,\n", opts.bots, stats.tick_percentile(0.5));
+    std::fprintf(f, "    \"net.%d.corrections\": %llu\n", opts.bots, (unsigned long long) corrections);
+    std::fprintf(f, "  }\n}\n");
+    return std::fclose(f) == 0;
+}
+
+static void usage(const char* name) {
+    std::fprintf(
+            stderr,
+            "usage: %s [options]\n"
+            "  --port N           UDP port (default %d, 0 picks a free one)\n"
+            "  --size N | WxHxL   maze size in cells (default %dx%dx%d)\n"
+            "  --seed N           maze seed (default random)\n"
+            "  --load FILE        play in the maze of a binary maze file\n"
+            "  --ticks N          stop after N ticks (default never)\n"
+            "  --bots N           join N bots over loopback that move at random\n"
+            "  --loss PERCENT     drop that many of the packets both ways\n"
+            "  --json FILE        write the traffic and tick time to FILE\n",
+            name,
+            NET_DEFAULT_PORT,
+            MAZE_WIDTH,
+            MAZE_HEIGHT,
+            MAZE_LENGTH);
+}
+
+static bool parse_server_options(int argc, char** argv, server_options& opts) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (!std::strcmp(arg, "--port") && value) {
+            int port = std::atoi(value);
+            if (port < 0 || port > 65535) {
+                std::fprintf(stderr, "bad port: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            opts.port = (uint16_t) port;
+            i++;
+        } else if (!std::strcmp(arg, "--size") && value) {
+            if (!parse_maze_size(value, opts.size)) {
+                std::fprintf(stderr, "bad maze size: %s\n", value);
+                usage(argv[0]);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--seed") && value) {
+            opts.seed = std::strtoul(value, nullptr, 0);
+            i++;
+        } else if (!std::strcmp(arg, "--load") && value) {
+            opts.load_path = value;
+            i++;
+        } else if (!std::strcmp(arg, "--ticks") && value) {
+            opts.ticks = std::max(0, std::atoi(value));
+            i++;
+        } else if (!std::strcmp(arg, "--bots") && value) {
+            opts.bots = std::atoi(value);
+            if (opts.bots < 0 || opts.bots > NET_MAX_PLAYERS) {
+                std::fprintf(stderr, "bad bot count: %s, the server takes %d players\n", value, NET_MAX_PLAYERS);
+                return false;
+            }
+            i++;
+        } else if (!std::strcmp(arg, "--loss") && value) {
+            opts.loss_percent = glm::clamp(std::atoi(value), 0, 100);
+            i++;
+        } else if (!std::strcmp(arg, "--json") && value) {
+            opts.json_path = value;
+            i++;
+        } else {
+            if (std::strcmp(arg, "--help"))
+                std::fprintf(stderr, "unknown option: %s\n", arg);
+            usage(argv[0]);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv) {
+    server_options opts;
+    if (!parse_server_options(argc, argv, opts))
+        return 1;
+
+    // the cells are never generated here, clients do that from the seed
+    maze m(opts.size, opts.seed);
+    if (opts.load_path && !m.load(opts.load_path))
+        return 1;
+
+    net_server server;
+    if (!server.start(opts.port, m.get_seed(), m.get_size()))
+        return 1;
+    server.socket.loss_percent = opts.loss_percent;
+
+    glm::ivec3 size = m.get_size();
+    std::printf("serving a %dx%dx%d maze with seed %u on port %u\n",
+                size.x, size.y, size.z, m.get_seed(), server.socket.local_port());
+
+    std::signal(SIGINT, on_signal);
+
+    std::atomic<bool> bots_ready{opts.bots == 0};
+    uint64_t corrections = 0;
+    std::thread bots;
+    if (opts.bots) {
+        net_address loopback;
+        loopback.host = 0x7F000001;
+        loopback.port = server.socket.local_port();
+        bots = std::thread(run_bots, loopback, opts.bots, std::ref(bots_ready), std::ref(corrections));
+    }
+
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::nanoseconds(1000000000 / SIM_TICK_RATE);
+
+    server_stats stats;
+    bool measuring = false;
+    int ticks = 0;
+    auto next = clock::now();
+    auto last_report = next;
+    while (running && (!opts.ticks || ticks < opts.ticks)) {
+        // the bots' connects and first full snapshots aren't counted
+        if (!measuring && bots_ready) {
+            measuring = true;
+            stats.begin(server);
+        }
+
+        auto start = clock::now();
+        server.step();
+        if (measuring) {
+            stats.tick_ms.push_back(std::chrono::duration<double, std::milli>(clock::now() - start).count());
+            ticks++;
+        }
+
+        if (!opts.ticks && clock::now() - last_report > std::chrono::seconds(SERVER_REPORT_SECONDS)) {
+            stats.finish(server);
+            print_stats(stats, server.players());
+            stats.begin(server);
+            last_report = clock::now();
+        }
+
+        next += period;
+        if (clock::now() - next > SIM_MAX_CATCH_UP * period)
+            next = clock::now();
+        std::this_thread::sleep_until(next);
+    }
+
+    running = false;
+    if (bots.joinable())
+        bots.join();
+
+    // all zero traffic and tick times would pass as an improvement
+    if (bots_failed) {
+        std::fprintf(stderr, "ERROR: Server: a bot could not connect, nothing was measured\n");
+        return 1;
+    }
+    if (opts.json_path && stats.tick_ms.empty()) {
+        std::fprintf(stderr, "ERROR: Server: no tick was measured, %s is not written\n", opts.json_path);
+        return 1;
+    }
+
+    stats.finish(server);
+    print_stats(stats, server.players());
+    if (opts.bots)
+        std::printf("  bots: %llu corrections\n", (unsigned long long) corrections);
+
+    if (opts.json_path && !write_json(opts.json_path, opts, stats, corrections))
+        return 1;
+
+    // lost packets are the only thing that makes prediction miss
+    if (corrections && !opts.loss_percent) {
+        std::fprintf(stderr, "ERROR: Server: the bots' prediction missed without packet loss\n");
+        return 1;
+    }
+
+    return 0;
+}
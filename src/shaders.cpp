@@ -1,4 +1,5 @@
 #include "shaders.h"
+#include "trace.h"
 #include <GL/glew.h>
 #include <cstdio>
 
@@ -85,6 +86,7 @@ bool link_shaders(GLuint shader_ids[SHADER_COUNT],
 }
 
 bool compile_shaders_and_link_programs(GLuint program_ids[PROGRAM_COUNT]) {
+    TRACE_ZONE("compile_shaders_and_link_programs");
     GLuint shader_ids[SHADER_COUNT];
     return compile_shaders(shader_ids)
         && link_shaders(shader_ids, program_ids)
@@ -4,9 +4,34 @@
 #include <GL/glew.h>
 
 #define SHADER_CODE(...) #__VA_ARGS__
+// expands x before turning it into a string.
+#define SHADER_STRING(x) SHADER_CODE(x)
 
-enum shader_names { SHADER_BASIC_VERT, SHADER_BASIC_FRAG, SHADER_MINIMAP_VERT, SHADER_MINIMAP_FRAG, SHADER_COUNT };
-enum program_names { PROGRAM_BASIC, PROGRAM_MINIMAP, PROGRAM_COUNT };
+// views of the split screen the maze programs can draw in one go.
+#define SHADER_MAX_VIEWS 4
+// layers of the material array, a vertex with a material past the last one
+// isn't textured (the arrow).
+#define SHADER_MATERIALS 4
+
+// The light the camera carries by the squared distance, what the maze
+// programs scale a wall by. The renderer culls the walls too far for it to
+// show (see camera_light_cutoff) from the same formula.
+#define CAMERA_LIGHT(dist2) (90.0 / ((dist2) + 50.0))
+#define CAMERA_LIGHT_DEFINE "#define CAMERA_LIGHT(dist2) " SHADER_STRING(CAMERA_LIGHT(dist2)) "\n"
+
+// Texture coordinates of a wall from the position in cells (p) and the axis
+// it faces, whole numbers at the corners of a cell so a material repeats once
+// per cell. The second one is up along the walls around a floor.
+#define WALL_UV_DEFINE "#define WALL_UV(p, axis) ((axis).x > 0.5 ? (p).zy : (axis).y > 0.5 ? (p).xz : (p).xy)\n"
+
+// The albedo of a wall, white past the last material. Sampled either way,
+// the derivatives of uv are only there outside of a branch.
+#define MATERIAL_DEFINE "#define ALBEDO(materials, uv, material) " \
+        "mix(vec3(1.0), texture(materials, vec3(uv, float(material))).rgb, " \
+        "float((material) < " SHADER_STRING(SHADER_MATERIALS) "u))\n"
+
+enum shader_names { SHADER_BASIC_VERT, SHADER_BASIC_FRAG, SHADER_MINIMAP_VERT, SHADER_MINIMAP_FRAG, SHADER_OVERLAY_VERT, SHADER_OVERLAY_FRAG, SHADER_LIT_VERT, SHADER_LIT_FRAG, SHADER_VIEWS_VERT, SHADER_VIEWS_FRAG, SHADER_LIT_VIEWS_VERT, SHADER_LIT_VIEWS_FRAG, SHADER_UPSCALE_VERT, SHADER_UPSCALE_FRAG, SHADER_COUNT };
+enum program_names { PROGRAM_BASIC, PROGRAM_MINIMAP, PROGRAM_OVERLAY, PROGRAM_LIT, PROGRAM_VIEWS, PROGRAM_LIT_VIEWS, PROGRAM_UPSCALE, PROGRAM_COUNT };
 
 /**
  * @brief Shader information before compilation.
@@ -17,45 +42,169 @@ struct pre_shader {
     const char* source;
 };
 
+// The basic and the lit program transform the same way. The camera goes to
+// the fragment shader as eye, so the views programs can share it.
+#define BASIC_VERT_SOURCE "#version 450 core\n" WALL_UV_DEFINE SHADER_CODE( \
+        layout (location = 0) in vec3 attrib_pos; \
+        layout (location = 1) in vec3 attrib_color; \
+        layout (location = 2) in vec2 attrib_ao; \
+        layout (location = 4) in uint attrib_material; \
+ \
+        out vec4 vertex_color; \
+        out vec3 pos; \
+        out vec2 ao; \
+        out vec2 uv; \
+        flat out vec3 eye; \
+        flat out uint material; \
+ \
+        uniform mat4 mvp; \
+        uniform vec3 cam_pos; \
+        uniform float wall_size; \
+ \
+        void main(){ \
+            vertex_color = vec4(attrib_color, 1.0); \
+            vec4 position = mvp * vec4(attrib_pos, 1.0); \
+            pos = attrib_pos; \
+            ao = attrib_ao; \
+            uv = WALL_UV(attrib_pos / wall_size + 0.5, attrib_color); \
+            eye = cam_pos; \
+            material = attrib_material; \
+            gl_Position = position; \
+        })
+
+// The views programs draw every view of the split screen at once. Each view
+// has its own mvp and camera, attrib_view (per instance, so a draw picks it
+// with its base instance) says which, and the vertex goes to the viewport of
+// that view. Only used where the driver can write gl_ViewportIndex from a
+// vertex shader (it still compiles elsewhere). Writing it isn't free, so a
+// single view keeps the basic programs.
+#define VIEWS_VERT_SOURCE "#version 450 core\n" \
+        "#extension GL_ARB_shader_viewport_layer_array : enable\n" \
+        "#extension GL_AMD_vertex_shader_viewport_index : enable\n" \
+        "#if defined(GL_ARB_shader_viewport_layer_array) || defined(GL_AMD_vertex_shader_viewport_index)\n" \
+        "#define SET_VIEWPORT(view) gl_ViewportIndex = view\n" \
+        "#else\n" \
+        "#define SET_VIEWPORT(view)\n" \
+        "#endif\n" \
+        "#define MAX_VIEWS " SHADER_STRING(SHADER_MAX_VIEWS) "\n" WALL_UV_DEFINE SHADER_CODE( \
+        layout (location = 0) in vec3 attrib_pos; \
+        layout (location = 1) in vec3 attrib_color; \
+        layout (location = 2) in vec2 attrib_ao; \
+        layout (location = 3) in uint attrib_view; \
+        layout (location = 4) in uint attrib_material; \
+ \
+        out vec4 vertex_color; \
+        out vec3 pos; \
+        out vec2 ao; \
+        out vec2 uv; \
+        flat out vec3 eye; \
+        flat out uint material; \
+ \
+        uniform mat4 mvp[MAX_VIEWS]; \
+        uniform vec3 cam_pos[MAX_VIEWS]; \
+        uniform float wall_size; \
+ \
+        void main(){ \
+            int view = int(attrib_view); \
+            vertex_color = vec4(attrib_color, 1.0); \
+            vec4 position = mvp[view] * vec4(attrib_pos, 1.0); \
+            pos = attrib_pos; \
+            ao = attrib_ao; \
+            uv = WALL_UV(attrib_pos / wall_size + 0.5, attrib_color); \
+            eye = cam_pos[view]; \
+            material = attrib_material; \
+            gl_Position = position; \
+            SET_VIEWPORT(view); \
+        })
+
+#define BASIC_FRAG_SOURCE "#version 450 core\n" CAMERA_LIGHT_DEFINE MATERIAL_DEFINE SHADER_CODE( \
+        in  vec4 vertex_color; \
+        in  vec3 pos; \
+        in  vec2 ao; \
+        in  vec2 uv; \
+        flat in vec3 eye; \
+        flat in uint material; \
+        layout(location = 0) out vec4 color; \
+ \
+        uniform sampler2DArray materials; \
+ \
+        void main() \
+        { \
+            float dist = length(pos - eye); \
+            float camera_light = CAMERA_LIGHT(dist * dist); \
+ \
+            /* walls are colored with the axis they face, ao has the */ \
+            /* occlusion of their negative and their positive side */ \
+            float side_ao = dot(vertex_color.rgb, eye - pos) < 0.0 ? ao.x : ao.y; \
+            color = vec4(ALBEDO(materials, uv, material) * camera_light * side_ao, camera_light); \
+        })
+
+#define LIT_FRAG_SOURCE "#version 450 core\n" CAMERA_LIGHT_DEFINE MATERIAL_DEFINE SHADER_CODE( \
+        in  vec4 vertex_color; \
+        in  vec3 pos; \
+        in  vec2 ao; \
+        in  vec2 uv; \
+        flat in vec3 eye; \
+        flat in uint material; \
+        layout(location = 0) out vec4 color; \
+ \
+        uniform sampler2DArray materials; \
+ \
+        /* lights are pairs of (pos, radius) (color, intensity), cells are */ \
+        /* (first index, count) into light_indices. */ \
+        layout (std430, binding = 0) readonly buffer light_buffer { vec4 lights[]; }; \
+        layout (std430, binding = 1) readonly buffer light_cell_buffer { uvec2 light_cells[]; }; \
+        layout (std430, binding = 2) readonly buffer light_index_buffer { uint light_indices[]; }; \
+ \
+        uniform ivec3 grid_origin; \
+        uniform int grid_size; \
+        uniform float wall_size; \
+ \
+        void main() \
+        { \
+            float dist = length(pos - eye); \
+            float camera_light = CAMERA_LIGHT(dist * dist); \
+ \
+            /* walls are colored with the axis they face, the side seen is */ \
+            /* the one facing the camera */ \
+            float facing_side = dot(vertex_color.rgb, eye - pos); \
+            vec3 normal = vertex_color.rgb * sign(facing_side); \
+            float side_ao = facing_side < 0.0 ? ao.x : ao.y; \
+            ivec3 cell = ivec3(floor((pos + 0.25 * wall_size * normal) / wall_size + 0.5)) - grid_origin; \
+ \
+            vec3 lit = vec3(0.0); \
+            if (all(greaterThanEqual(cell, ivec3(0))) && all(lessThan(cell, ivec3(grid_size)))) { \
+                uvec2 range = light_cells[(cell.z * grid_size + cell.y) * grid_size + cell.x]; \
+                for (uint i = range.x; i < range.x + range.y; i++) { \
+                    uint l = light_indices[i]; \
+                    vec4 pos_radius = lights[2 * l]; \
+                    vec4 color_intensity = lights[2 * l + 1]; \
+ \
+                    vec3 to_light = pos_radius.xyz - pos; \
+                    float d = length(to_light); \
+                    float falloff = clamp(1.0 - d / pos_radius.w, 0.0, 1.0); \
+                    float facing = max(dot(normal, to_light / d), 0.0); \
+                    lit += color_intensity.rgb * color_intensity.w * falloff * falloff * facing; \
+                } \
+            } \
+ \
+            float brightest = max(lit.r, max(lit.g, lit.b)); \
+            vec3 albedo = ALBEDO(materials, uv, material); \
+            color = vec4((vec3(camera_light) + lit) * side_ao * albedo, clamp(camera_light + brightest, 0.0, 1.0)); \
+        })
+
 const pre_shader pre_shaders[SHADER_COUNT] = {
     {
         // 0 - SHADER_BASIC_VERT
         GL_VERTEX_SHADER,
         PROGRAM_BASIC,
-        "#version 450 core\n" SHADER_CODE(
-        layout (location = 0) in vec3 attrib_pos;
-        layout (location = 1) in vec3 attrib_color;
-
-        out vec4 vertex_color;
-        out vec3 pos;
-
-        uniform mat4 mvp;
-        uniform vec3 cam_pos;
-
-        void main(){
-            vertex_color = vec4(attrib_color, 1.0);
-            vec4 position = mvp * vec4(attrib_pos, 1.0);
-            pos = attrib_pos;
-            gl_Position = position;
-        }),
+        BASIC_VERT_SOURCE,
     },
     {
         // 1 - SHADER_BASIC_FRAG
         GL_FRAGMENT_SHADER,
         PROGRAM_BASIC,
-        "#version 450 core\n" SHADER_CODE(
-        in  vec4 vertex_color;
-        in  vec3 pos;
-        layout(location = 0) out vec4 color;
-        uniform vec3 cam_pos;
-
-        void main()
-        {
-            float dist = length(pos - cam_pos);
-            dist = dist * dist;
-            // TODO: redo this
-            color = vec4(1.0) * 90.0 / (dist + 50.0);
-        }),
+        BASIC_FRAG_SOURCE,
     },
     {
         // 2 - SHADER_POST_VERT
@@ -89,6 +238,116 @@ const pre_shader pre_shaders[SHADER_COUNT] = {
             color = col;
         }),
     },
+    {
+        // 4 - SHADER_OVERLAY_VERT
+        GL_VERTEX_SHADER,
+        PROGRAM_OVERLAY,
+        "#version 450 core\n" SHADER_CODE(
+        layout (location = 0) in vec2 attrib_pos;
+        layout (location = 1) in vec2 attrib_uv;
+        layout (location = 2) in vec4 attrib_color;
+
+        out vec2 uv;
+        out vec4 vertex_color;
+
+        uniform vec2 screen_size;
+
+        void main() {
+            vec2 ndc = attrib_pos / screen_size * 2.0 - 1.0;
+            gl_Position = vec4(ndc.x, -ndc.y, 0.0, 1.0);
+            uv = attrib_uv;
+            vertex_color = attrib_color;
+        }),
+    },
+    {
+        // 5 - SHADER_OVERLAY_FRAG
+        GL_FRAGMENT_SHADER,
+        PROGRAM_OVERLAY,
+        "#version 450 core\n" SHADER_CODE(
+        in  vec2 uv;
+        in  vec4 vertex_color;
+        out vec4 color;
+
+        uniform sampler2D atlas;
+
+        void main()
+        {
+            color = vec4(vertex_color.rgb, vertex_color.a * texture(atlas, uv).r);
+        }),
+    },
+    {
+        // 6 - SHADER_LIT_VERT
+        GL_VERTEX_SHADER,
+        PROGRAM_LIT,
+        BASIC_VERT_SOURCE,
+    },
+    {
+        // 7 - SHADER_LIT_FRAG, the basic one plus the lights of the light
+        // grid. A program of its own so mazes without lights don't pay for
+        // the storage buffer reads.
+        GL_FRAGMENT_SHADER,
+        PROGRAM_LIT,
+        LIT_FRAG_SOURCE,
+    },
+    {
+        // 8 - SHADER_VIEWS_VERT
+        GL_VERTEX_SHADER,
+        PROGRAM_VIEWS,
+        VIEWS_VERT_SOURCE,
+    },
+    {
+        // 9 - SHADER_VIEWS_FRAG
+        GL_FRAGMENT_SHADER,
+        PROGRAM_VIEWS,
+        BASIC_FRAG_SOURCE,
+    },
+    {
+        // 10 - SHADER_LIT_VIEWS_VERT
+        GL_VERTEX_SHADER,
+        PROGRAM_LIT_VIEWS,
+        VIEWS_VERT_SOURCE,
+    },
+    {
+        // 11 - SHADER_LIT_VIEWS_FRAG
+        GL_FRAGMENT_SHADER,
+        PROGRAM_LIT_VIEWS,
+        LIT_FRAG_SOURCE,
+    },
+    {
+        // 12 - SHADER_UPSCALE_VERT, one triangle over the viewport, no
+        // vertex data. source is the part of the scene texture it shows.
+        GL_VERTEX_SHADER,
+        PROGRAM_UPSCALE,
+        "#version 450 core\n" SHADER_CODE(
+        out vec2 uv;
+
+        uniform vec4 source;
+
+        void main() {
+            vec2 corner = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+            gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+            uv = source.xy + corner * source.zw;
+        }),
+    },
+    {
+        // 13 - SHADER_UPSCALE_FRAG, the sampler filters it bilinearly. The
+        // edge texels aren't blended with what is past them, another view
+        // or nothing.
+        GL_FRAGMENT_SHADER,
+        PROGRAM_UPSCALE,
+        "#version 450 core\n" SHADER_CODE(
+        in  vec2 uv;
+        out vec4 color;
+
+        uniform sampler2D scene;
+        uniform vec4 source;
+
+        void main()
+        {
+            vec2 half_texel = 0.5 / vec2(textureSize(scene, 0));
+            color = texture(scene, clamp(uv, source.xy + half_texel, source.xy + source.zw - half_texel));
+        }),
+    },
 };
 
 bool compile_shaders(GLuint shaders_ids[SHADER_COUNT]);
@@ -0,0 +1,195 @@
+#include "simulation.h"
+#include "input_log.h"
+#include "net_client.h"
+#include "trace.h"
+
+#include <chrono>
+
+#include <glm/gtx/rotate_vector.hpp>
+
+#define MOUSE_SENSITIVITY 0.005f
+
+int64_t sim_clock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void mouse_look(glm::vec3& front, glm::vec3& up, glm::vec3& right, glm::ivec2 dmouse) {
+    right = glm::rotate(glm::rotate(right, MOUSE_SENSITIVITY * -dmouse.x, up), MOUSE_SENSITIVITY * -dmouse.y, right);
+    front = glm::rotate(glm::rotate(front, MOUSE_SENSITIVITY * -dmouse.x, up), MOUSE_SENSITIVITY * -dmouse.y, right);
+    up = glm::cross(right, front);
+}
+
+void camera_at(const frame_state& frame,
+               int player,
+               int64_t time,
+               glm::ivec2 mouse_sent,
+               glm::vec3& pos,
+               glm::vec3& front,
+               glm::vec3& up) {
+    const player_state& p = frame.player[player];
+
+    // draw one tick in the past, between the previous and the latest tick
+    float alpha = (time - frame.time) * 1e-9f / SIM_DT;
+    alpha = glm::clamp(alpha, 0.0f, 1.0f);
+    pos = glm::mix(p.prev_cam_pos, p.cam_pos, alpha);
+
+    front = p.cam_front;
+    up = p.cam_up;
+    glm::vec3 right = p.cam_right;
+    glm::ivec2 pending = mouse_sent - p.mouse_consumed;
+    if (pending != glm::ivec2(0))
+        mouse_look(front, up, right, pending);
+}
+
+void step_player(player_state& p, uint32_t held, glm::ivec2 dmouse) {
+    const float step = SIM_PLAYER_SPEED * SIM_DT;
+    p.prev_cam_pos = p.cam_pos;
+
+    if (held & (1 << FORWARD)) {
+        p.cam_pos += step * p.cam_front;
+    }
+
+    if (held & (1 << BACKWARD)) {
+        p.cam_pos -= step * p.cam_front;
+    }
+
+    if (held & (1 << RIGHT)) {
+        p.cam_pos += step * p.cam_right;
+    }
+
+    if (held & (1 << LEFT)) {
+        p.cam_pos -= step * p.cam_right;
+    }
+
+    if (held & (1 << UP)) {
+        p.cam_pos += step * p.cam_up;
+    }
+
+    if (held & (1 << DOWN)) {
+        p.cam_pos -= step * p.cam_up;
+    }
+
+    mouse_look(p.cam_front, p.cam_up, p.cam_right, dmouse);
+    p.mouse_consumed += dmouse;
+}
+
+void spawn_player(player_state& p, int index) {
+    p = player_state();
+    p.cam_front = glm::rotate(p.cam_front, glm::radians(90.0f * index), p.cam_up);
+    p.cam_right = glm::cross(p.cam_front, p.cam_up);
+}
+
+simulation::simulation() {
+    for (int i = 0; i < SIM_MAX_PLAYERS; i++)
+        spawn_player(state.player[i], i);
+
+    frames.back() = state;
+    frames.publish();
+}
+
+simulation::~simulation() {
+    stop();
+}
+
+void simulation::start() {
+    running = true;
+    thread = std::thread(&simulation::run, this);
+}
+
+void simulation::stop() {
+    running = false;
+    if (thread.joinable())
+        thread.join();
+}
+
+void simulation::run() {
+    using clock = std::chrono::steady_clock;
+    const auto period = std::chrono::nanoseconds(1000000000 / SIM_TICK_RATE);
+
+    trace_thread_name("simulation");
+
+    auto next = clock::now();
+    while (running) {
+        tick();
+
+        // after a long stall, drop the ticks that can't be caught up on
+        next += period;
+        if (clock::now() - next > SIM_MAX_CATCH_UP * period)
+            next = clock::now();
+
+        std::this_thread::sleep_until(next);
+    }
+}
+
+void simulation::apply(const input_event& event) {
+    if (event.player >= players)
+        return;
+
+    switch (event.type) {
+    case INPUT_KEY_DOWN:
+        icontroller[event.player].key_down((motions) event.motion);
+        break;
+    case INPUT_KEY_UP:
+        icontroller[event.player].key_up((motions) event.motion);
+        break;
+    case INPUT_MOUSE:
+        dmouse[event.player] += glm::ivec2(event.dx, event.dy);
+        break;
+    }
+}
+
+void simulation::tick() {
+    TRACE_ZONE("sim tick");
+    int64_t start = sim_clock();
+
+    // input is applied at the start of the tick it is recorded with
+    uint32_t now = (uint32_t) state.tick;
+
+    input_event event;
+    while (inputs.pop(event)) {
+        if (replay)
+            continue;
+
+        apply(event);
+        if (recording)
+            recording->records.push_back({ now, event });
+    }
+
+    if (replay) {
+        while (replay_next < replay->records.size() && replay->records[replay_next].tick <= now)
+            apply(replay->records[replay_next++].event);
+    }
+
+    state.input_held = false;
+    for (int i = 0; i < players; i++) {
+        uint32_t held = 0;
+        for (int m = 0; m < NUM_MOTIONS; m++) {
+            if (icontroller[i].is_active((motions) m))
+                held |= 1 << m;
+        }
+        icontroller[i].reload();
+        state.input_held = state.input_held || held;
+
+        if (i == 0 && net)
+            net->tick(state.player[0], held, dmouse[0]);
+        else
+            step_player(state.player[i], held, dmouse[i]);
+        dmouse[i] = glm::ivec2(0);
+    }
+
+    if (net) {
+        state.remote_players = net->remote_players(sim_clock(), state.remote_pos, SIM_MAX_REMOTE_PLAYERS);
+        state.disconnected = net->lost(sim_clock());
+    }
+
+    state.tick++;
+    state.time = sim_clock();
+    if (recording)
+        recording->ticks = (uint32_t) state.tick;
+    if (replay)
+        state.replay_done = state.tick >= replay->ticks;
+    state.tick_time = state.time - start;
+    frames.back() = state;
+    frames.publish();
+}
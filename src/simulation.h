@@ -0,0 +1,162 @@
+#ifndef IT_SIMULATION_H
+#define IT_SIMULATION_H
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "input_controller.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+// The simulation advances in fixed steps, independent of the frame rate.
+#define SIM_TICK_RATE 120
+#define SIM_DT (1.0f / SIM_TICK_RATE)
+// ticks the simulation may run back to back to catch up after a stall.
+#define SIM_MAX_CATCH_UP 8
+// local players, each one gets a view of the split screen.
+#define SIM_MAX_PLAYERS 4
+// units per second, the same for the local players and over the network.
+#define SIM_PLAYER_SPEED 6.0f
+// other players of a networked game a frame holds, the server only sends
+// the nearest ones.
+#define SIM_MAX_REMOTE_PLAYERS 8
+
+enum input_event_type { INPUT_KEY_DOWN, INPUT_KEY_UP, INPUT_MOUSE };
+
+/**
+ * @brief Input sent from the thread polling SDL to the simulation.
+ */
+struct input_event {
+    uint8_t type;
+    uint8_t motion;
+    int16_t dx;
+    int16_t dy;
+    // who it is for, 0 is the keyboard and mouse.
+    uint8_t player;
+};
+
+/**
+ * @brief The camera of one player.
+ */
+struct player_state {
+    glm::vec3 prev_cam_pos = glm::vec3(0.0f, 0.0f, 3.0f);
+    glm::vec3 cam_pos = glm::vec3(0.0f, 0.0f, 3.0f);
+    glm::vec3 cam_up = glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 cam_front = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 cam_right = glm::cross(cam_front, cam_up);
+
+    // all the mouse movement applied to the camera so far.
+    glm::ivec2 mouse_consumed = glm::ivec2(0);
+};
+
+/**
+ * @brief Immutable snapshot of the simulation, all the render thread reads.
+ */
+struct frame_state {
+    uint64_t tick = 0;
+    // steady clock time of this tick, and how long it took, in nanoseconds.
+    int64_t time = 0;
+    int64_t tick_time = 0;
+
+    // the ones past simulation::players don't move.
+    player_state player[SIM_MAX_PLAYERS];
+
+    // other players of a networked game, interpolated a little in the past.
+    int remote_players = 0;
+    glm::vec3 remote_pos[SIM_MAX_REMOTE_PLAYERS];
+
+    // a motion of some player is active, the next ticks may move it.
+    bool input_held = false;
+
+    // a replay ran out of input.
+    bool replay_done = false;
+    // the server stopped sending snapshots.
+    bool disconnected = false;
+};
+
+/**
+ * @brief Turns the camera by a mouse movement. Shared by the simulation and
+ * the render thread, which applies input the simulation hasn't seen yet.
+ */
+void mouse_look(glm::vec3& front, glm::vec3& up, glm::vec3& right, glm::ivec2 dmouse);
+
+/**
+ * @brief The camera of player to draw a frame with, at time (steady clock,
+ * ns). Position is interpolated between the last two ticks, orientation is
+ * the latest plus the mouse movement sent after it (mouse_sent - consumed).
+ */
+void camera_at(const frame_state& frame,
+               int player,
+               int64_t time,
+               glm::ivec2 mouse_sent,
+               glm::vec3& pos,
+               glm::vec3& front,
+               glm::vec3& up);
+
+/**
+ * @brief Moves a player one tick. Bit m of held is set when motion m was
+ * active during it, dmouse is the mouse movement of the tick. The server
+ * moves networked players with it too, so prediction agrees with it.
+ */
+void step_player(player_state& p, uint32_t held, glm::ivec2 dmouse);
+
+/**
+ * @brief Where player index starts: everyone in the same cell, each looking
+ * another way.
+ */
+void spawn_player(player_state& p, int index);
+
+int64_t sim_clock();
+
+struct input_log;
+class net_client;
+
+/**
+ * @brief Runs input and camera movement on its own thread. Input comes in
+ * through inputs, every tick ends with a snapshot published to frames.
+ */
+class simulation {
+    input_controller icontroller[SIM_MAX_PLAYERS];
+    frame_state state;
+
+    // mouse movement since the last tick
+    glm::ivec2 dmouse[SIM_MAX_PLAYERS] = {};
+
+    std::atomic<bool> running{false};
+    std::thread thread;
+
+    size_t replay_next = 0;
+
+    void run();
+    void apply(const input_event& event);
+
+public:
+    spsc_queue<input_event, 1024> inputs;
+    triple_buffer<frame_state> frames;
+
+    // set before the first tick. Every input applied is appended to
+    // recording; with replay the input comes from it instead of inputs.
+    input_log* recording = nullptr;
+    const input_log* replay = nullptr;
+    // players moved, set before the first tick. Input for the others is
+    // dropped.
+    int players = 1;
+    // set before the first tick. The first player is predicted from the
+    // input sent to the server and corrected by its snapshots, the other
+    // players of the game come from it.
+    net_client* net = nullptr;
+
+    simulation();
+    ~simulation();
+
+    void start();
+    void stop();
+
+    // one step, only called by the simulation thread.
+    void tick();
+};
+
+#endif
@@ -0,0 +1,173 @@
+#include "snapshot.h"
+
+#include <cmath>
+#include <cstring>
+
+enum snapshot_field {
+    FIELD_POS_X = 1 << 0,
+    FIELD_POS_Y = 1 << 1,
+    FIELD_POS_Z = 1 << 2,
+    FIELD_FRONT = 1 << 3,
+    FIELD_UP = 1 << 4,
+};
+
+bool net_player::operator==(const net_player& other) const {
+    return id == other.id &&
+        !std::memcmp(pos, other.pos, sizeof(pos)) &&
+        !std::memcmp(front, other.front, sizeof(front)) &&
+        !std::memcmp(up, other.up, sizeof(up));
+}
+
+const net_player* snapshot::find(uint8_t id) const {
+    for (int i = 0; i < count; i++) {
+        if (players[i].id == id)
+            return &players[i];
+    }
+    return nullptr;
+}
+
+static float sign_not_zero(float v) {
+    return v < 0.0f ? -1.0f : 1.0f;
+}
+
+// Octahedral: the unit sphere projected onto an octahedron, its lower half
+// folded over the upper one and flattened into the [-1, 1] square.
+static void encode_dir(glm::vec3 v, int16_t out[2]) {
+    v /= std::abs(v.x) + std::abs(v.y) + std::abs(v.z);
+    float x = v.x;
+    float y = v.y;
+    if (v.z < 0.0f) {
+        x = (1.0f - std::abs(v.y)) * sign_not_zero(v.x);
+        y = (1.0f - std::abs(v.x)) * sign_not_zero(v.y);
+    }
+
+    out[0] = (int16_t) std::lround(glm::clamp(x, -1.0f, 1.0f) * 32767.0f);
+    out[1] = (int16_t) std::lround(glm::clamp(y, -1.0f, 1.0f) * 32767.0f);
+}
+
+static glm::vec3 decode_dir(const int16_t in[2]) {
+    float x = in[0] / 32767.0f;
+    float y = in[1] / 32767.0f;
+
+    glm::vec3 v(x, y, 1.0f - std::abs(x) - std::abs(y));
+    if (v.z < 0.0f) {
+        v.x = (1.0f - std::abs(y)) * sign_not_zero(x);
+        v.y = (1.0f - std::abs(x)) * sign_not_zero(y);
+    }
+    return glm::normalize(v);
+}
+
+void quantize_player(const player_state& p, uint8_t id, net_player& q) {
+    q.id = id;
+    for (int i = 0; i < 3; i++)
+        q.pos[i] = (int32_t) std::lround(p.cam_pos[i] * NET_POS_SCALE);
+    encode_dir(p.cam_front, q.front);
+    encode_dir(p.cam_up, q.up);
+}
+
+void dequantize_player(const net_player& q, player_state& p) {
+    p.cam_pos = glm::vec3(q.pos[0], q.pos[1], q.pos[2]) / NET_POS_SCALE;
+
+    // the two directions are quantized apart, square them up again
+    p.cam_front = decode_dir(q.front);
+    p.cam_right = glm::normalize(glm::cross(p.cam_front, decode_dir(q.up)));
+    p.cam_up = glm::cross(p.cam_right, p.cam_front);
+}
+
+void net_spawn(player_state& p, net_player& q, uint8_t id) {
+    spawn_player(p, id);
+    quantize_player(p, id, q);
+    dequantize_player(q, p);
+    p.prev_cam_pos = p.cam_pos;
+}
+
+void net_step(player_state& p, net_player& q, const net_command& cmd) {
+    glm::ivec2 dmouse(cmd.dx, cmd.dy);
+    step_player(p, cmd.held, dmouse);
+
+    net_player moved;
+    quantize_player(p, q.id, moved);
+    if (dmouse == glm::ivec2(0)) {
+        std::memcpy(moved.front, q.front, sizeof(q.front));
+        std::memcpy(moved.up, q.up, sizeof(q.up));
+    }
+
+    q = moved;
+    dequantize_player(q, p);
+}
+
+void write_snapshot(net_writer& w, const snapshot* base, const snapshot& current) {
+    static const net_player zero;
+
+    w.u8((uint8_t) current.count);
+    for (int i = 0; i < current.count; i++) {
+        const net_player& q = current.players[i];
+        const net_player* b = base ? base->find(q.id) : nullptr;
+        if (!b)
+            b = &zero;
+
+        uint8_t fields = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            if (q.pos[axis] != b->pos[axis])
+                fields |= FIELD_POS_X << axis;
+        }
+        if (std::memcmp(q.front, b->front, sizeof(q.front)))
+            fields |= FIELD_FRONT;
+        if (std::memcmp(q.up, b->up, sizeof(q.up)))
+            fields |= FIELD_UP;
+
+        w.u8(q.id);
+        w.u8(fields);
+        for (int axis = 0; axis < 3; axis++) {
+            if (fields & (FIELD_POS_X << axis))
+                w.svarint(q.pos[axis] - b->pos[axis]);
+        }
+        if (fields & FIELD_FRONT) {
+            w.svarint(q.front[0] - b->front[0]);
+            w.svarint(q.front[1] - b->front[1]);
+        }
+        if (fields & FIELD_UP) {
+            w.svarint(q.up[0] - b->up[0]);
+            w.svarint(q.up[1] - b->up[1]);
+        }
+    }
+}
+
+bool read_snapshot(net_reader& r, const snapshot* base, snapshot& out) {
+    static const net_player zero;
+
+    out.count = r.u8();
+    if (out.count > NET_SNAPSHOT_PLAYERS)
+        return false;
+
+    for (int i = 0; i < out.count; i++) {
+        net_player& q = out.players[i];
+        q.id = r.u8();
+        if (q.id >= NET_MAX_PLAYERS || (i > 0 && q.id <= out.players[i - 1].id))
+            return false;
+
+        const net_player* b = base ? base->find(q.id) : nullptr;
+        if (!b)
+            b = &zero;
+
+        uint8_t fields = r.u8();
+        for (int axis = 0; axis < 3; axis++) {
+            q.pos[axis] = b->pos[axis];
+            if (fields & (FIELD_POS_X << axis))
+                q.pos[axis] += r.svarint();
+        }
+
+        std::memcpy(q.front, b->front, sizeof(q.front));
+        std::memcpy(q.up, b->up, sizeof(q.up));
+        if (fields & FIELD_FRONT) {
+            q.front[0] = (int16_t) (q.front[0] + r.svarint());
+            q.front[1] = (int16_t) (q.front[1] + r.svarint());
+        }
+        if (fields & FIELD_UP) {
+            q.up[0] = (int16_t) (q.up[0] + r.svarint());
+            q.up[1] = (int16_t) (q.up[1] + r.svarint());
+        }
+    }
+
+    return !r.error;
+}
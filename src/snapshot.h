@@ -0,0 +1,87 @@
+#ifndef IT_SNAPSHOT_H
+#define IT_SNAPSHOT_H
+
+#include <cstdint>
+
+#include "net.h"
+#include "simulation.h"
+
+// players a server takes, and the ids they get.
+#define NET_MAX_PLAYERS       32
+// players in one snapshot: the client's own and the ones nearest to it, so a
+// snapshot is the same size however many play.
+#define NET_SNAPSHOT_PLAYERS  8
+// positions are sent in fixed point, 1 / NET_POS_SCALE units apart.
+#define NET_POS_SCALE         64.0f
+// server ticks between two snapshots to a client.
+#define NET_SNAPSHOT_INTERVAL 4
+// snapshots kept to decode deltas against, on both ends.
+#define NET_SNAPSHOT_HISTORY  32
+// commands an input packet carries at most.
+#define NET_INPUT_REDUNDANCY  8
+
+static_assert(SIM_MAX_REMOTE_PLAYERS >= NET_SNAPSHOT_PLAYERS, "a frame can't hold a snapshot");
+
+/**
+ * @brief A player the way it is sent: the position in fixed point, the front
+ * and up directions octahedral encoded into two 16 bit numbers each.
+ */
+struct net_player {
+    uint8_t id = 0;
+    int32_t pos[3] = {};
+    int16_t front[2] = {};
+    int16_t up[2] = {};
+
+    bool operator==(const net_player& other) const;
+};
+
+/**
+ * @brief The players one client gets at a server tick, sorted by id.
+ */
+struct snapshot {
+    uint32_t tick = 0;
+    int count = 0;
+    net_player players[NET_SNAPSHOT_PLAYERS];
+
+    // nullptr when id isn't in it.
+    const net_player* find(uint8_t id) const;
+};
+
+/**
+ * @brief Input of one tick of a networked player: the motions held (bit m for
+ * motion m) and the mouse movement.
+ */
+struct net_command {
+    uint8_t held = 0;
+    int16_t dx = 0;
+    int16_t dy = 0;
+};
+
+void quantize_player(const player_state& p, uint8_t id, net_player& q);
+
+// sets the position and orientation of p, keeps the rest.
+void dequantize_player(const net_player& q, player_state& p);
+
+/**
+ * @brief Where player id starts, on the grid it is sent on.
+ */
+void net_spawn(player_state& p, net_player& q, uint8_t id);
+
+/**
+ * @brief Moves p one tick of cmd, then puts it back on the grid q it is sent
+ * as. The server moves every player with it and the client predicts its own
+ * with it, so both end on the same numbers and a correction means a packet
+ * was lost. The orientation is only quantized again when it turned, so
+ * standing still doesn't drift.
+ */
+void net_step(player_state& p, net_player& q, const net_command& cmd);
+
+/**
+ * @brief Writes current as the change from base: per player a mask of the
+ * fields that changed and the difference of each, so a player standing still
+ * costs two bytes. Without a base everything is sent against zero.
+ */
+void write_snapshot(net_writer& w, const snapshot* base, const snapshot& current);
+bool read_snapshot(net_reader& r, const snapshot* base, snapshot& out);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef IT_SPSC_QUEUE_H
+#define IT_SPSC_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * @brief Lock free single producer, single consumer ring buffer. N has to be
+ * a power of two, push() fails instead of waiting when it is full.
+ */
+template <typename T, size_t N>
+class spsc_queue {
+    static_assert((N & (N - 1)) == 0, "spsc_queue size must be a power of two");
+
+    T items[N];
+    alignas(64) std::atomic<size_t> head{0};
+    alignas(64) std::atomic<size_t> tail{0};
+
+public:
+    bool push(const T& item) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N)
+            return false;
+
+        items[t & (N - 1)] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire))
+            return false;
+
+        item = items[h & (N - 1)];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> trace_enabled{false};
+
+struct trace_event {
+    const char* name;
+    int64_t start;
+    int64_t end;
+};
+
+/**
+ * @brief Written only by its thread. head counts every event ever written,
+ * the reader uses it to tell which slots were overwritten while it copied.
+ */
+struct trace_buffer {
+    trace_event events[TRACE_BUFFER_EVENTS];
+    std::atomic<uint64_t> head{0};
+    int tid = 0;
+    const char* name = nullptr;
+};
+
+// buffers are never freed, a thread may still be writing to its own when
+// the trace is dumped.
+static std::mutex registry_lock;
+static std::vector<std::unique_ptr<trace_buffer>> buffers;
+
+static thread_local trace_buffer* local_buffer = nullptr;
+static thread_local const char* local_name = nullptr;
+
+int64_t trace_clock() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static trace_buffer* thread_buffer() {
+    if (!local_buffer) {
+        auto buffer = std::make_unique<trace_buffer>();
+
+        std::lock_guard<std::mutex> guard(registry_lock);
+        buffer->tid = (int) buffers.size() + 1;
+        buffer->name = local_name;
+        local_buffer = buffer.get();
+        buffers.push_back(std::move(buffer));
+    }
+
+    return local_buffer;
+}
+
+void trace_record(const char* name, int64_t start, int64_t end) {
+    trace_buffer* buffer = thread_buffer();
+
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    buffer->events[head & (TRACE_BUFFER_EVENTS - 1)] = { name, start, end };
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void trace_thread_name(const char* name) {
+    local_name = name;
+
+    // buffers are only made once a thread records something
+    if (local_buffer) {
+        std::lock_guard<std::mutex> guard(registry_lock);
+        local_buffer->name = name;
+    }
+}
+
+bool trace_dump(const char* path) {
+    std::FILE* f = std::fopen(path, "w");
+    if (!f) {
+        std::fprintf(stderr, "ERROR: Trace: could not create %s\n", path);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> guard(registry_lock);
+
+    struct thread_events {
+        int tid;
+        const char* name;
+        std::vector<trace_event> events;
+    };
+
+    std::vector<thread_events> threads;
+    int64_t base = INT64_MAX;
+
+    for (const auto& buffer : buffers) {
+        thread_events t = { buffer->tid, buffer->name, {} };
+
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = head > TRACE_BUFFER_EVENTS ? head - TRACE_BUFFER_EVENTS : 0;
+        for (uint64_t i = first; i < head; i++)
+            t.events.push_back(buffer->events[i & (TRACE_BUFFER_EVENTS - 1)]);
+
+        // slots the thread got around to again while they were copied are
+        // dropped, they may be half written
+        uint64_t after = buffer->head.load(std::memory_order_acquire);
+        size_t overwritten = 0;
+        while (overwritten < t.events.size() && first + overwritten + TRACE_BUFFER_EVENTS <= after)
+            overwritten++;
+        t.events.erase(t.events.begin(), t.events.begin() + overwritten);
+
+        for (const trace_event& e : t.events)
+            base = std::min(base, e.start);
+
+        threads.push_back(std::move(t));
+    }
+
+    std::fprintf(f, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+
+    bool first_event = true;
+    auto separator = [&]() {
+        const char* s = first_event ? "" : ",\n";
+        first_event = false;
+        return s;
+    };
+
+    for (const thread_events& t : threads) {
+        if (t.name) {
+            std::fprintf(f, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                            "\"args\": {\"name\": \"%s\"}}",
+                         separator(), t.tid, t.name);
+        }
+
+        for (const trace_event& e : t.events) {
+            std::fprintf(f, "%s{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                            "\"ts\": %.3f, \"dur\": %.3f}",
+                         separator(),
+                         e.name,
+                         t.tid,
+                         (e.start - base) * 1e-3,
+                         (e.end - e.start) * 1e-3);
+        }
+    }
+
+    std::fprintf(f, "\n]}\n");
+    return std::fclose(f) == 0;
+}
@@ -0,0 +1,63 @@
+#ifndef IT_TRACE_H
+#define IT_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+
+// events kept per thread, older ones are overwritten. Power of two.
+#define TRACE_BUFFER_EVENTS (1 << 16)
+
+// zones only record while this is set.
+extern std::atomic<bool> trace_enabled;
+
+int64_t trace_clock();
+
+/**
+ * @brief Appends a finished zone to the ring buffer of the calling thread.
+ * name has to outlive the trace, a string literal.
+ */
+void trace_record(const char* name, int64_t start, int64_t end);
+
+/**
+ * @brief Names the calling thread in the trace, a string literal.
+ */
+void trace_thread_name(const char* name);
+
+/**
+ * @brief Writes what the ring buffers of every thread hold as Chrome trace
+ * event JSON (opens in Perfetto and chrome://tracing). Can be called while
+ * other threads keep recording.
+ */
+bool trace_dump(const char* path);
+
+/**
+ * @brief Records the time between its construction and destruction.
+ */
+class trace_zone {
+    const char* name;
+    int64_t start;
+
+public:
+    explicit trace_zone(const char* name) :
+        name(name),
+        start(trace_enabled.load(std::memory_order_relaxed) ? trace_clock() : 0) {}
+
+    ~trace_zone() {
+        if (start)
+            trace_record(name, start, trace_clock());
+    }
+
+    trace_zone(const trace_zone&) = delete;
+    trace_zone& operator=(const trace_zone&) = delete;
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#ifdef IT_NO_TRACE
+#define TRACE_ZONE(name)
+#else
+#define TRACE_ZONE(name) trace_zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef IT_TRIPLE_BUFFER_H
+#define IT_TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * @brief Lock free single producer, single consumer triple buffer.
+ *
+ * The writer fills back() and publish()es it, the reader calls fetch() and
+ * then reads front(). There is always a slot for each side plus the one in
+ * the middle, so neither side ever waits on the other; the reader just gets
+ * the latest published value.
+ */
+template <typename T>
+class triple_buffer {
+    // index of the middle slot, plus a bit telling if it holds something the
+    // reader didn't see yet.
+    static constexpr uint8_t FRESH = 0x4;
+
+    T slots[3];
+    std::atomic<uint8_t> middle{1};
+    uint8_t back_index = 0;
+    uint8_t front_index = 2;
+
+public:
+    T& back() { return slots[back_index]; }
+
+    void publish() {
+        uint8_t old = middle.exchange(back_index | FRESH, std::memory_order_acq_rel);
+        back_index = old & ~FRESH;
+    }
+
+    // returns true if front() changed.
+    bool fetch() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+
+        uint8_t old = middle.exchange(front_index, std::memory_order_acq_rel);
+        front_index = old & ~FRESH;
+        return true;
+    }
+
+    const T& front() const { return slots[front_index]; }
+};
+
+#endif